@@ -0,0 +1,685 @@
+#include <limits.h>
+#include "header.h"
+#include "registry.h"
+#include "archive.h"
+
+static const char *counter_series[ COUNTER_AMOUNT ] =
+{
+    "counter.receiver.SIGUSR1", "counter.receiver.SIGUSR2",
+    "counter.generator.SIGUSR1", "counter.generator.SIGUSR2"
+};
+
+/**
+ * Writer state of the reporter process
+ */
+static struct archive_writer
+{
+    int                   fd;
+    int                   index_fd;
+    uint64_t              end;            /* data offset of the next block */
+    uint64_t              blocks;
+    struct archive_header header;
+    struct metric        *metric[ ARCHIVE_MAX_SERIES ];
+    unsigned char         block[ ARCHIVE_BLOCK_BYTES ];
+    uint32_t              length;
+    uint32_t              records;
+    int64_t               first_ms;
+    int64_t               last_ms;
+    int64_t               last_delta;
+    int64_t               previous[ ARCHIVE_MAX_SERIES ];
+} writer = { .fd = -1, .index_fd = -1 };
+
+/**
+ * Reader state walking the records of one block
+ */
+struct archive_decoder
+{
+    const unsigned char *at;
+    const unsigned char *end;
+    uint                 series;
+    uint32_t             records;
+    int64_t              ms;
+    int64_t              delta;
+    int64_t              value[ ARCHIVE_MAX_SERIES ];
+};
+
+/**
+ * Result of a range query, the records closest to both ends
+ */
+struct archive_range
+{
+    uint64_t blocks;
+    uint64_t records;
+    uint     blocks_read;
+    int64_t  first_ms;
+    int64_t  last_ms;
+    int64_t  first[ ARCHIVE_MAX_SERIES ];
+    int64_t  last[ ARCHIVE_MAX_SERIES ];
+};
+
+static uint64_t zigzag( int64_t value )
+{
+    return ( (uint64_t)value << 1 ) ^ (uint64_t)( value >> 63 );
+}
+
+static int64_t unzigzag( uint64_t value )
+{
+    return (int64_t)( value >> 1 ) ^ -(int64_t)( value & 1 );
+}
+
+static uint put_varint( unsigned char *out, uint64_t value )
+{
+    uint length = 0;
+
+    while ( value >= 0x80 )
+    {
+        out[ length++ ] = (unsigned char)value | 0x80;
+        value >>= 7;
+    }
+    out[ length++ ] = (unsigned char)value;
+
+    return length;
+}
+
+static uint64_t get_varint( struct archive_decoder *decoder )
+{
+    uint64_t value = 0;
+
+    for ( uint shift = 0; decoder->at < decoder->end && shift < 64; shift += 7 )
+    {
+        unsigned char byte = *decoder->at++;
+
+        value |= (uint64_t)( byte & 0x7f ) << shift;
+        if ( !( byte & 0x80 ) ) break;
+    }
+
+    return value;
+}
+
+/**
+ * Returns the wall clock time in milliseconds
+ *
+ * @return int64_t
+ */
+static int64_t wall_clock_ms()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_REALTIME, &ts );
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Returns the index file path of the archive 'path'
+ *
+ * @param  const char * path
+ * @param  char *       index_path
+ * @return char *       index_path
+ */
+static char *index_path( const char *path, char *index_path )
+{
+    snprintf( index_path, PATH_MAX, "%s.idx", path );
+
+    return index_path;
+}
+
+/**
+ * Write the pending block and its index entry
+ */
+static void flush_block()
+{
+    if ( writer.records == 0 ) return;
+
+    struct archive_index entry =
+    {
+        .first_ms = writer.first_ms,
+        .last_ms  = writer.last_ms,
+        .offset   = writer.end,
+        .length   = writer.length,
+        .records  = writer.records,
+    };
+
+    // - The block is only reachable once its index entry is written
+    if ( pwrite( writer.fd, writer.block, writer.length, writer.end ) == (ssize_t)writer.length )
+    {
+        if ( pwrite( writer.index_fd, &entry, sizeof( entry ), writer.blocks * sizeof( entry ) ) == sizeof( entry ) )
+        {
+            writer.end += writer.length;
+            writer.blocks++;
+        }
+    }
+
+    writer.length  = 0;
+    writer.records = 0;
+}
+
+/**
+ * Encode one record into the pending block, flushed when full
+ *
+ * @param int64_t   ms
+ * @param int64_t * value
+ */
+static void encode_record( int64_t ms, const int64_t *value )
+{
+    unsigned char *out = writer.block + writer.length;
+    uint series = writer.header.series;
+
+    // - Every block starts against zero
+    if ( writer.records == 0 )
+    {
+        writer.first_ms   = 0;
+        writer.last_ms    = 0;
+        writer.last_delta = 0;
+        memset( writer.previous, 0, sizeof( writer.previous ) );
+    }
+
+    int64_t delta = ms - writer.last_ms;
+
+    out += put_varint( out, zigzag( writer.records == 0 ? ms : delta - writer.last_delta ) );
+    writer.last_delta = writer.records == 0 ? 0 : delta;
+
+    for ( uint i = 0; i < series; )
+    {
+        int64_t change = value[i] - writer.previous[i];
+
+        if ( change != 0 )
+        {
+            out += put_varint( out, zigzag( change ) );
+            writer.previous[i] = value[i];
+            i++;
+            continue;
+        }
+
+        // - A run of unchanged series is a zero and the run length
+        uint run = 1;
+        while ( i + run < series && value[ i + run ] == writer.previous[ i + run ] ) run++;
+
+        out += put_varint( out, 0 );
+        out += put_varint( out, run - 1 );
+        i += run;
+    }
+
+    if ( writer.records == 0 ) writer.first_ms = ms;
+
+    writer.last_ms = ms;
+    writer.length  = out - writer.block;
+
+    if ( ++writer.records == ARCHIVE_BLOCK_RECORDS ) flush_block();
+}
+
+/**
+ * Decode the next record of the block into 'decoder'
+ *
+ * @param  struct archive_decoder * decoder
+ * @return int 0 at the end of the block
+ */
+static int decode_record( struct archive_decoder *decoder )
+{
+    if ( decoder->at >= decoder->end ) return 0;
+
+    int64_t dod = unzigzag( get_varint( decoder ) );
+
+    if ( decoder->records == 0 )
+    {
+        decoder->ms    = dod;
+        decoder->delta = 0;
+        memset( decoder->value, 0, sizeof( decoder->value ) );
+    }
+    else
+    {
+        decoder->delta += dod;
+        decoder->ms    += decoder->delta;
+    }
+
+    for ( uint i = 0; i < decoder->series; )
+    {
+        uint64_t token = get_varint( decoder );
+
+        if ( token != 0 ) decoder->value[ i++ ] += unzigzag( token );
+        else i += get_varint( decoder ) + 1;
+    }
+
+    decoder->records++;
+
+    return 1;
+}
+
+/**
+ * Create or reopen the archive 'path' holding the series 'name'.
+ * An existing archive is appended to when it holds the same series
+ *
+ * @param  const char * path
+ * @param  const char   name[][ ARCHIVE_NAME_LENGTH ]
+ * @param  uint         series
+ * @return int
+ */
+static int create_archive( const char *path, char name[][ ARCHIVE_NAME_LENGTH ], uint series )
+{
+    char   index_name[ PATH_MAX ];
+    struct archive_header existing;
+    struct stat           status;
+
+    memset( &writer.header, 0, sizeof( writer.header ) );
+    writer.header.magic         = ARCHIVE_MAGIC;
+    writer.header.version       = ARCHIVE_VERSION;
+    writer.header.series        = series;
+    writer.header.block_records = ARCHIVE_BLOCK_RECORDS;
+    memcpy( writer.header.name, name, series * ARCHIVE_NAME_LENGTH );
+
+    writer.fd       = open( path, O_CREAT | O_RDWR, 0666 );
+    writer.index_fd = open( index_path( path, index_name ), O_CREAT | O_RDWR, 0666 );
+
+    if ( writer.fd == -1 || writer.index_fd == -1 )
+    {
+        perror( "open()" );
+        archive_close();
+        return 0;
+    }
+
+    if ( pread( writer.fd, &existing, sizeof( existing ), 0 ) == sizeof( existing ) )
+    {
+        if ( memcmp( &existing, &writer.header, sizeof( existing ) ) != 0 )
+        {
+            fprintf( stderr, "Archive %s holds other series, not appending\n", path );
+            archive_close();
+            return 0;
+        }
+
+        // - Resume after the last indexed block, dropping a torn tail
+        fstat( writer.index_fd, &status );
+        writer.blocks = status.st_size / sizeof( struct archive_index );
+        writer.end    = sizeof( struct archive_header );
+
+        if ( writer.blocks > 0 )
+        {
+            struct archive_index last;
+
+            pread( writer.index_fd, &last, sizeof( last ), ( writer.blocks - 1 ) * sizeof( last ) );
+            writer.end = last.offset + last.length;
+        }
+    }
+    else
+    {
+        writer.blocks = 0;
+        writer.end    = sizeof( struct archive_header );
+
+        if ( pwrite( writer.fd, &writer.header, sizeof( writer.header ), 0 ) != sizeof( writer.header ) )
+        {
+            perror( "pwrite()" );
+            archive_close();
+            return 0;
+        }
+    }
+
+    ftruncate( writer.fd, writer.end );
+    ftruncate( writer.index_fd, writer.blocks * sizeof( struct archive_index ) );
+
+    writer.length  = 0;
+    writer.records = 0;
+
+    return 1;
+}
+
+/**
+ * Open the archive for the reporter, the series are the four counters
+ * followed by the metrics registered so far
+ *
+ * @param  const char * path
+ * @return int
+ */
+int archive_open( const char *path )
+{
+    static char    name[ ARCHIVE_MAX_SERIES ][ ARCHIVE_NAME_LENGTH ];
+    struct metric *metric[ METRICS_CAPACITY ];
+    uint           series = 0;
+
+    for ( uint i = 0; i < COUNTER_AMOUNT; i++ )
+    {
+        writer.metric[ series ] = NULL;
+        snprintf( name[ series++ ], ARCHIVE_NAME_LENGTH, "%s", counter_series[i] );
+    }
+
+    uint count = metrics_collect( metric, METRICS_CAPACITY );
+
+    for ( uint i = 0; i < count && series < ARCHIVE_MAX_SERIES; i++ )
+    {
+        writer.metric[ series ] = metric[i];
+        snprintf( name[ series++ ], ARCHIVE_NAME_LENGTH, "%s", metric[i]->name );
+    }
+
+    return create_archive( path, name, series );
+}
+
+/**
+ * Append the 'snapshot' counters and the current metric values
+ *
+ * @param struct report_snapshot * snapshot
+ */
+void archive_append( struct report_snapshot *snapshot )
+{
+    int64_t value[ ARCHIVE_MAX_SERIES ];
+
+    if ( writer.fd == -1 ) return;
+
+    for ( uint i = 0; i < writer.header.series; i++ )
+    {
+        value[i] = writer.metric[i] ? __atomic_load_n( &writer.metric[i]->value, __ATOMIC_RELAXED ) : snapshot->counter[i];
+    }
+
+    encode_record( wall_clock_ms(), value );
+}
+
+/**
+ * Flush the pending block and close the archive
+ */
+void archive_close()
+{
+    if ( writer.fd != -1 ) flush_block();
+
+    if ( writer.fd != -1 ) close( writer.fd );
+    if ( writer.index_fd != -1 ) close( writer.index_fd );
+
+    writer.fd = writer.index_fd = -1;
+}
+
+/**
+ * Decode block 'entry' of the archive into 'buffer' and position 'decoder'
+ * on the first record at or after 'from_ms' (first != 0) or on the last
+ * record at or before 'to_ms' (first == 0)
+ *
+ * @param  int                      fd
+ * @param  struct archive_index *   entry
+ * @param  uint                     series
+ * @param  int64_t                  ms
+ * @param  int                      first
+ * @param  struct archive_decoder * decoder
+ * @return int 0 when no record qualifies
+ */
+static int seek_record( int fd, struct archive_index *entry, uint series, int64_t ms, int first, struct archive_decoder *decoder )
+{
+    static unsigned char buffer[ ARCHIVE_BLOCK_BYTES ];
+    struct archive_decoder probe;
+    int found = 0;
+
+    if ( entry->length > sizeof( buffer ) || pread( fd, buffer, entry->length, entry->offset ) != entry->length ) return 0;
+
+    memset( &probe, 0, sizeof( probe ) );
+    probe.at     = buffer;
+    probe.end    = buffer + entry->length;
+    probe.series = series;
+
+    while ( decode_record( &probe ) )
+    {
+        if ( first && probe.ms >= ms )
+        {
+            *decoder = probe;
+            return 1;
+        }
+        if ( !first )
+        {
+            if ( probe.ms > ms ) break;
+
+            *decoder = probe;
+            found = 1;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Find the records closest to both ends of [ from_ms, to_ms ]
+ * reading only the index and the two blocks holding the ends
+ *
+ * @param  const char *           path
+ * @param  int64_t                from_ms
+ * @param  int64_t                to_ms
+ * @param  struct archive_header * header
+ * @param  struct archive_range *  range
+ * @return int 1 found, 0 no record in range, -1 on error
+ */
+static int query_range( const char *path, int64_t from_ms, int64_t to_ms, struct archive_header *header, struct archive_range *range )
+{
+    char   index_name[ PATH_MAX ];
+    struct stat status;
+    struct archive_decoder decoder;
+    int    result = -1;
+
+    int fd       = open( path, O_RDONLY );
+    int index_fd = open( index_path( path, index_name ), O_RDONLY );
+
+    if ( fd == -1 || index_fd == -1
+         || pread( fd, header, sizeof( *header ), 0 ) != sizeof( *header )
+         || header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION
+         || header->series > ARCHIVE_MAX_SERIES
+         || fstat( index_fd, &status ) == -1 )
+    {
+        goto done;
+    }
+
+    uint64_t blocks = status.st_size / sizeof( struct archive_index );
+    struct archive_index *index = malloc( blocks * sizeof( struct archive_index ) + 1 );
+
+    if ( index == NULL || pread( index_fd, index, blocks * sizeof( struct archive_index ), 0 ) != (ssize_t)( blocks * sizeof( struct archive_index ) ) )
+    {
+        free( index );
+        goto done;
+    }
+
+    memset( range, 0, sizeof( *range ) );
+    range->blocks = blocks;
+    for ( uint64_t i = 0; i < blocks; i++ ) range->records += index[i].records;
+
+    // - First block ending at or after 'from', last block starting at or before 'to'
+    uint64_t low = 0, high = blocks;
+    while ( low < high )
+    {
+        uint64_t middle = ( low + high ) / 2;
+        if ( index[ middle ].last_ms < from_ms ) low = middle + 1; else high = middle;
+    }
+    uint64_t first_block = low;
+
+    low = 0, high = blocks;
+    while ( low < high )
+    {
+        uint64_t middle = ( low + high ) / 2;
+        if ( index[ middle ].first_ms <= to_ms ) low = middle + 1; else high = middle;
+    }
+
+    result = 0;
+
+    if ( first_block < blocks && low > 0 && first_block <= low - 1 )
+    {
+        uint64_t last_block = low - 1;
+
+        if ( seek_record( fd, &index[ first_block ], header->series, from_ms, 1, &decoder ) )
+        {
+            range->first_ms = decoder.ms;
+            memcpy( range->first, decoder.value, sizeof( range->first ) );
+
+            if ( seek_record( fd, &index[ last_block ], header->series, to_ms, 0, &decoder ) && decoder.ms >= range->first_ms )
+            {
+                range->last_ms = decoder.ms;
+                memcpy( range->last, decoder.value, sizeof( range->last ) );
+                result = 1;
+            }
+        }
+        range->blocks_read = first_block == last_block ? 1 : 2;
+    }
+
+    free( index );
+
+done:
+    if ( fd != -1 ) close( fd );
+    if ( index_fd != -1 ) close( index_fd );
+
+    return result;
+}
+
+/**
+ * Parse a query bound: epoch seconds, "-n" seconds before 'reference_ms'
+ * or 'fallback' when empty
+ *
+ * @param  const char * bound
+ * @param  int64_t      reference_ms
+ * @param  int64_t      fallback
+ * @return int64_t
+ */
+static int64_t parse_bound( const char *bound, int64_t reference_ms, int64_t fallback )
+{
+    if ( bound == NULL || *bound == '\0' ) return fallback;
+    if ( *bound == '-' ) return reference_ms - (int64_t)( strtod( bound + 1, NULL ) * 1000 );
+
+    return (int64_t)( strtod( bound, NULL ) * 1000 );
+}
+
+/**
+ * The 'query' sub program: display the value change and the rate of every
+ * series between 'from' and 'to'
+ *
+ * @param  const char * path
+ * @param  const char * from
+ * @param  const char * to
+ * @return int exit status
+ */
+int archive_query( const char *path, const char *from, const char *to )
+{
+    struct archive_header header;
+    struct archive_range  range;
+    struct stat           status;
+    char                  index_name[ PATH_MAX ];
+
+    uint64_t started = get_timestamp_ns();
+    int64_t  now_ms  = wall_clock_ms();
+    int64_t  to_ms   = parse_bound( to, now_ms, INT64_MAX );
+    int64_t  from_ms = parse_bound( from, to_ms == INT64_MAX ? now_ms : to_ms, INT64_MIN );
+
+    int found = query_range( path, from_ms, to_ms, &header, &range );
+    double elapsed_ms = ( get_timestamp_ns() - started ) / 1e6;
+
+    if ( found < 0 )
+    {
+        fprintf( stderr, "Cannot read the archive %s\n", path );
+        return EXIT_FAILURE;
+    }
+
+    uint64_t bytes = 0;
+    if ( stat( path, &status ) == 0 ) bytes += status.st_size;
+    if ( stat( index_path( path, index_name ), &status ) == 0 ) bytes += status.st_size;
+
+    uint64_t raw = range.records * 8 * ( header.series + 1 );
+
+    printf( "Archive %s: %llu records in %llu blocks, %llu bytes (raw %llu, %.1fx)\n", path,
+            (unsigned long long)range.records, (unsigned long long)range.blocks,
+            (unsigned long long)bytes, (unsigned long long)raw, bytes ? (double)raw / bytes : 0.0 );
+
+    if ( !found )
+    {
+        printf( "No records in range, %.3f ms\n", elapsed_ms );
+        return EXIT_SUCCESS;
+    }
+
+    double seconds = ( range.last_ms - range.first_ms ) / 1e3;
+    time_t first = range.first_ms / 1000, last = range.last_ms / 1000;
+    char   first_string[ 32 ], last_string[ 32 ];
+
+    strftime( first_string, sizeof( first_string ), "%F %T", localtime( &first ) );
+    strftime( last_string, sizeof( last_string ), "%F %T", localtime( &last ) );
+
+    printf( "Range %s ... %s, %.1fs, %u blocks decoded in %.3f ms\n", first_string, last_string,
+            seconds, range.blocks_read, elapsed_ms );
+    printf( "%-44s %14s %14s %12s %12s\n", "series", "first", "last", "delta", "rate/s" );
+
+    for ( uint i = 0; i < header.series; i++ )
+    {
+        int64_t delta = range.last[i] - range.first[i];
+
+        printf( "%-44.44s %14lli %14lli %12lli %12.2f\n", header.name[i], (long long)range.first[i],
+                (long long)range.last[i], (long long)delta, seconds > 0 ? delta / seconds : 0.0 );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * The 'archive-bench' sub program: write a day of 1 Hz snapshots of
+ * synthetic series to 'path', then time random range queries
+ *
+ * @param  const char * path
+ * @return int exit status
+ */
+int archive_benchmark( const char *path )
+{
+    static char name[ ARCHIVE_MAX_SERIES ][ ARCHIVE_NAME_LENGTH ];
+    int64_t     value[ ARCHIVE_MAX_SERIES ];
+    char        index_name[ PATH_MAX ];
+    uint        series = 64;
+    uint        records = 86400;
+    uint        queries = 1000;
+
+    unlink( path );
+    unlink( index_path( path, index_name ) );
+
+    // - Every series moves every second: counters and histogram sample counts
+    // - grow at their own rate between a few and a few thousand per second,
+    // - every fourth series is a gauge doing a random walk
+    uint rate[ ARCHIVE_MAX_SERIES ];
+
+    for ( uint i = 0; i < series; i++ )
+    {
+        snprintf( name[i], ARCHIVE_NAME_LENGTH, "series.%u", i );
+        rate[i] = 4 + ( i * 2654435761u ) % 4000;
+    }
+    memset( value, 0, sizeof( value ) );
+
+    if ( !create_archive( path, name, series ) ) return EXIT_FAILURE;
+
+    int64_t  start_ms = wall_clock_ms() - (int64_t)records * 1000;
+    uint64_t started  = get_timestamp_ns();
+
+    for ( uint r = 0; r < records; r++ )
+    {
+        for ( uint i = 0; i < series; i++ )
+        {
+            if ( i % 4 == 3 ) value[i] = llabs( value[i] + rand() % 21 - 10 );
+            else              value[i] += rate[i] / 2 + rand() % rate[i];
+        }
+
+        encode_record( start_ms + (int64_t)r * 1000 + rand() % 3, value );
+    }
+    archive_close();
+
+    double write_ms = ( get_timestamp_ns() - started ) / 1e6;
+
+    struct stat status;
+    uint64_t bytes = 0, raw = (uint64_t)records * 8 * ( series + 1 );
+    if ( stat( path, &status ) == 0 ) bytes += status.st_size;
+    if ( stat( index_name, &status ) == 0 ) bytes += status.st_size;
+
+    printf( "%u records of %u series written in %.1f ms: %llu bytes, raw %llu, %.1fx smaller\n",
+            records, series, write_ms, (unsigned long long)bytes, (unsigned long long)raw, (double)raw / bytes );
+
+    // - Random ranges, checked against the synthetic counters' bounds
+    struct archive_header header;
+    struct archive_range  range;
+    uint failures = 0;
+
+    started = get_timestamp_ns();
+
+    for ( uint q = 0; q < queries; q++ )
+    {
+        int64_t from_ms = start_ms + (int64_t)( rand() % records ) * 1000;
+        int64_t to_ms   = from_ms + (int64_t)( 1 + rand() % 7200 ) * 1000;
+
+        if ( query_range( path, from_ms, to_ms, &header, &range ) != 1 || range.last[0] < range.first[0] ) failures++;
+    }
+
+    double query_ms = ( get_timestamp_ns() - started ) / 1e6;
+
+    printf( "%u range queries: %.3f ms per query, %u failed\n", queries, query_ms / queries, failures );
+
+    unlink( path );
+    unlink( index_name );
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
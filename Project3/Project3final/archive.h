@@ -0,0 +1,51 @@
+#ifndef _ARCHIVE_H_
+#define _ARCHIVE_H_
+
+/* Description:
+ * Time-series archive of the counter snapshots.
+ * The reporter appends a record per report to 'path': the wall clock time
+ * and the value of every series (the four counters, then the counters,
+ * gauges and histogram sample counts of the metric registry). Records are
+ * grouped in blocks of ARCHIVE_BLOCK_RECORDS; inside a block the time is
+ * stored as a zigzag varint delta-of-delta and each series as a zigzag
+ * varint delta of its previous value, runs of unchanged series collapse to
+ * one zero token and a run length. The first record of a block is stored
+ * against zero, so any block decodes on its own.
+ * Every flushed block gets an entry in 'path'.idx holding its time span and
+ * file offset, a range query binary searches the index and decodes only the
+ * two blocks holding the ends of the range.
+ */
+#include <stdint.h>
+
+#define ARCHIVE_MAGIC         0x41535443  /* "CTSA" */
+#define ARCHIVE_VERSION       1
+#define ARCHIVE_MAX_SERIES    128
+#define ARCHIVE_NAME_LENGTH   48
+#define ARCHIVE_BLOCK_RECORDS 256
+#define ARCHIVE_BLOCK_BYTES   ( ARCHIVE_BLOCK_RECORDS * ( 10 + ARCHIVE_MAX_SERIES * 10 ) )
+
+struct archive_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t series;
+    uint32_t block_records;
+    char     name[ ARCHIVE_MAX_SERIES ][ ARCHIVE_NAME_LENGTH ];
+};
+
+struct archive_index
+{
+    int64_t  first_ms;
+    int64_t  last_ms;
+    uint64_t offset;
+    uint32_t length;
+    uint32_t records;
+};
+
+int  archive_open( const char *path );
+void archive_append( struct report_snapshot *snapshot );
+void archive_close();
+int  archive_query( const char *path, const char *from, const char *to );
+int  archive_benchmark( const char *path );
+
+#endif /* _ARCHIVE_H_ */
@@ -0,0 +1,722 @@
+#include "header.h"
+#include "options.h"
+#include "registry.h"
+#include "stats.h"
+#include "sender.h"
+#include "bench.h"
+#include <math.h>
+#include <sys/utsname.h>
+
+// - What a sample child sends back over its pipe
+struct bench_sample
+{
+    int    ok;
+    double value[ BENCH_MAX_METRICS ];
+    long   max_rss_kb;
+};
+
+struct bench_case
+{
+    const char *name;
+    int       (*run)( double *value );
+    uint        metrics;
+    const char *metric[ BENCH_MAX_METRICS ];
+    int         higher_is_better[ BENCH_MAX_METRICS ];
+};
+
+static int compare_double( const void *a, const void *b )
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Returns the 'fraction' quantile of the 'count' durations, sorts them
+ *
+ * @param  double * duration
+ * @param  uint     count
+ * @param  double   fraction
+ * @return double
+ */
+static double quantile( double *duration, uint count, double fraction )
+{
+    qsort( duration, count, sizeof( double ), compare_double );
+
+    uint index = (uint)( fraction * ( count - 1 ) + 0.5 );
+
+    return duration[ index ];
+}
+
+// -------------------------------------------------------------------
+// -
+// - Cases, run by a fresh process with stdout on /dev/null
+// -
+// -------------------------------------------------------------------
+
+/**
+ * inc_counter() on the counter segment under the default lock
+ *
+ * @param  double * value ops/s, p50 ns, p99 ns
+ * @return int
+ */
+static int bench_inc_counter( double *value )
+{
+    static double duration[ BENCH_COUNTER_OPS ];
+
+    init_counters();
+
+    uint64_t started = get_timestamp_ns();
+
+    for ( uint i = 0; i < BENCH_COUNTER_OPS; i++ )
+    {
+        uint64_t before = get_timestamp_ns();
+        inc_counter( i % COUNTER_AMOUNT );
+        duration[i] = get_timestamp_ns() - before;
+    }
+
+    double seconds = ( get_timestamp_ns() - started ) / 1e9;
+
+    value[0] = BENCH_COUNTER_OPS / seconds;
+    value[1] = quantile( duration, BENCH_COUNTER_OPS, 0.50 );
+    value[2] = quantile( duration, BENCH_COUNTER_OPS, 0.99 );
+
+    remove_counters();
+
+    return 1;
+}
+
+/**
+ * sigqueue() / sigwaitinfo() ping-pong with a forked echo process,
+ * a round trip is one SIGUSR1 delivery and one SIGUSR2 delivery
+ *
+ * @param  double * value round trips/s, p50 ns, p99 ns
+ * @return int
+ */
+static int bench_signal_delivery( double *value )
+{
+    static double duration[ BENCH_ROUND_TRIPS ];
+    union sigval  payload = { .sival_int = 0 };
+    siginfo_t     info;
+    sigset_t      mask;
+
+    sigemptyset( &mask );
+    sigaddset( &mask, SIGUSR1 );
+    sigaddset( &mask, SIGUSR2 );
+    sigprocmask( SIG_BLOCK, &mask, NULL );
+
+    pid_t parent = getpid();
+    pid_t echo   = fork();
+
+    if ( echo == -1 ) return 0;
+
+    if ( echo == 0 )
+    {
+        sigdelset( &mask, SIGUSR2 );
+
+        while ( sigwaitinfo( &mask, &info ) != -1 || errno == EINTR )
+        {
+            if ( info.si_value.sival_int < 0 ) _exit( 0 );
+            sigqueue( parent, SIGUSR2, payload );
+        }
+        _exit( 1 );
+    }
+
+    sigdelset( &mask, SIGUSR1 );
+
+    uint64_t started = get_timestamp_ns();
+
+    for ( uint i = 0; i < BENCH_ROUND_TRIPS; i++ )
+    {
+        uint64_t before = get_timestamp_ns();
+
+        sigqueue( echo, SIGUSR1, payload );
+        while ( sigwaitinfo( &mask, &info ) == -1 && errno == EINTR );
+
+        duration[i] = get_timestamp_ns() - before;
+    }
+
+    double seconds = ( get_timestamp_ns() - started ) / 1e9;
+
+    payload.sival_int = -1;
+    sigqueue( echo, SIGUSR1, payload );
+    waitpid( echo, NULL, 0 );
+
+    value[0] = BENCH_ROUND_TRIPS / seconds;
+    value[1] = quantile( duration, BENCH_ROUND_TRIPS, 0.50 );
+    value[2] = quantile( duration, BENCH_ROUND_TRIPS, 0.99 );
+
+    return 1;
+}
+
+/**
+ * take_snapshot() + print_report() of populated counters, interval rings,
+ * metrics and sender table, flushed to /dev/null
+ *
+ * @param  double * value reports/s, p50 ns, p99 ns
+ * @return int
+ */
+static int bench_report( double *value )
+{
+    static double duration[ BENCH_REPORTS ];
+    struct report_snapshot snapshot[ 2 ];
+
+    init_counters();
+
+    if ( !stats_init( options.stats_window ) || !metrics_init() || !sender_init() )
+    {
+        remove_segments();
+        return 0;
+    }
+    register_metrics();
+
+    // - Something to report in every section
+    sender_register( 0 );
+    for ( uint i = 0; i < 4096; i++ )
+    {
+        inc_counter( i % COUNTER_AMOUNT );
+        stats_record( i & 1 );
+        sender_emitted( i & 1 );
+        sender_received( 0, i & 1, 0 );
+        observe_latency( get_timestamp_ns() - ( i % 64 + 1 ) * 1000 );
+    }
+
+    take_snapshot( &snapshot[0] );
+
+    uint64_t started = get_timestamp_ns();
+
+    for ( uint i = 0; i < BENCH_REPORTS; i++ )
+    {
+        uint64_t before = get_timestamp_ns();
+
+        take_snapshot( &snapshot[ ( i + 1 ) % 2 ] );
+        print_report( &snapshot[ i % 2 ], &snapshot[ ( i + 1 ) % 2 ] );
+        fflush( stdout );
+
+        duration[i] = get_timestamp_ns() - before;
+    }
+
+    double seconds = ( get_timestamp_ns() - started ) / 1e9;
+
+    value[0] = BENCH_REPORTS / seconds;
+    value[1] = quantile( duration, BENCH_REPORTS, 0.50 );
+    value[2] = quantile( duration, BENCH_REPORTS, 0.99 );
+
+    remove_segments();
+
+    return 1;
+}
+
+static const struct bench_case cases[] =
+{
+    { "inc_counter",     bench_inc_counter,     3, { "ops_per_s", "p50_ns", "p99_ns" },             { 1, 0, 0 } },
+    { "signal_delivery", bench_signal_delivery, 3, { "round_trips_per_s", "rtt_p50_ns", "rtt_p99_ns" }, { 1, 0, 0 } },
+    { "report",          bench_report,          3, { "reports_per_s", "p50_ns", "p99_ns" },         { 1, 0, 0 } }
+};
+
+#define BENCH_CASES ( sizeof( cases ) / sizeof( cases[0] ) )
+
+// -------------------------------------------------------------------
+// -
+// - Suite
+// -
+// -------------------------------------------------------------------
+
+/**
+ * Returns the peak resident set size of this process image
+ *
+ * @return long KiB
+ */
+static long peak_resident_kb()
+{
+    char line[ 128 ];
+    long peak = 0;
+
+    FILE *file = fopen( "/proc/self/status", "r" );
+    if ( file == NULL ) return 0;
+
+    while ( fgets( line, sizeof( line ), file ) )
+    {
+        if ( sscanf( line, "VmHWM: %ld", &peak ) == 1 ) break;
+    }
+    fclose( file );
+
+    return peak;
+}
+
+/**
+ * "./app bench-sample case fd", started by run_sample()
+ * Run one sample of the case and write the result to the pipe 'fd'
+ *
+ * @param  const char * index
+ * @param  const char * fd
+ * @return int exit status
+ */
+int bench_run_sample( const char *index, const char *fd )
+{
+    struct bench_sample result = { 0 };
+    uint bench = strtoul( index, NULL, 10 );
+
+    if ( bench >= BENCH_CASES ) return EXIT_FAILURE;
+
+    result.ok = cases[ bench ].run( result.value );
+
+    fflush( stdout );
+    result.max_rss_kb = peak_resident_kb();
+
+    ssize_t written = write( atoi( fd ), &result, sizeof( result ) );
+
+    return written == sizeof( result ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Run one sample of case 'bench' in a fresh image of this binary, so
+ * the peak RSS does not depend on the state of the suite process
+ *
+ * @param  uint                  bench
+ * @param  struct bench_sample * sample
+ * @return int
+ */
+static int run_sample( uint bench, struct bench_sample *sample )
+{
+    char index[ 16 ], fd[ 16 ];
+    int  channel[2];
+
+    if ( pipe( channel ) == -1 ) return 0;
+
+    fflush( stdout );
+    pid_t pid = fork();
+
+    if ( pid == -1 ) return 0;
+
+    if ( pid == 0 )
+    {
+        close( channel[0] );
+
+        int null_fd = open( "/dev/null", O_WRONLY );
+        if ( null_fd != -1 ) dup2( null_fd, STDOUT_FILENO );
+
+        snprintf( index, sizeof( index ), "%u", bench );
+        snprintf( fd, sizeof( fd ), "%i", channel[1] );
+
+        execl( "/proc/self/exe", "app", "bench-sample", index, fd, (char *)NULL );
+        _exit( 127 );
+    }
+
+    close( channel[1] );
+
+    ssize_t received = read( channel[0], sample, sizeof( *sample ) );
+
+    close( channel[0] );
+    waitpid( pid, NULL, 0 );
+
+    return received == sizeof( *sample ) && sample->ok;
+}
+
+/**
+ * Append the series 'case.metric' to 'results'
+ *
+ * @param  struct bench_results * results
+ * @param  const char *           bench
+ * @param  const char *           metric
+ * @param  int                    higher_is_better
+ * @return struct bench_series *
+ */
+static struct bench_series *add_series( struct bench_results *results, const char *bench, const char *metric, int higher_is_better )
+{
+    if ( results->series == BENCH_MAX_SERIES ) return NULL;
+
+    struct bench_series *series = &results->metric[ results->series++ ];
+
+    snprintf( series->name, sizeof( series->name ), "%s.%s", bench, metric );
+    series->higher_is_better = higher_is_better;
+    series->count = 0;
+
+    return series;
+}
+
+/**
+ * Run every case BENCH_SAMPLES times into 'results'
+ *
+ * @param  struct bench_results * results
+ * @return int
+ */
+static int run_suite( struct bench_results *results )
+{
+    results->series = 0;
+
+    for ( uint c = 0; c < BENCH_CASES; c++ )
+    {
+        const struct bench_case *bench = &cases[c];
+        struct bench_series *series[ BENCH_MAX_METRICS + 1 ];
+
+        for ( uint m = 0; m < bench->metrics; m++ )
+        {
+            series[m] = add_series( results, bench->name, bench->metric[m], bench->higher_is_better[m] );
+        }
+        series[ bench->metrics ] = add_series( results, bench->name, "max_rss_kb", 0 );
+
+        printf( "Running %-16s ", bench->name );
+
+        for ( uint s = 0; s < BENCH_SAMPLES; s++ )
+        {
+            struct bench_sample sample;
+
+            if ( !run_sample( c, &sample ) )
+            {
+                fprintf( stderr, "\nSample %u of %s failed\n", s, bench->name );
+                return 0;
+            }
+
+            for ( uint m = 0; m < bench->metrics; m++ ) series[m]->sample[ series[m]->count++ ] = sample.value[m];
+            series[ bench->metrics ]->sample[ series[ bench->metrics ]->count++ ] = sample.max_rss_kb;
+
+            printf( "." );
+            fflush( stdout );
+        }
+
+        printf( "\n" );
+    }
+
+    return 1;
+}
+
+/**
+ * Returns the median of the series
+ *
+ * @param  const struct bench_series * series
+ * @return double
+ */
+static double median( const struct bench_series *series )
+{
+    double sorted[ BENCH_SAMPLES ];
+
+    if ( series->count == 0 ) return 0;
+
+    memcpy( sorted, series->sample, series->count * sizeof( double ) );
+
+    return quantile( sorted, series->count, 0.5 );
+}
+
+// -------------------------------------------------------------------
+// -
+// - Baseline files
+// -
+// -------------------------------------------------------------------
+
+/**
+ * Describe this host as the baseline records it: name, machine and kernel
+ *
+ * @param char * host
+ * @param size_t size
+ */
+static void host_line( char *host, size_t size )
+{
+    struct utsname name;
+
+    uname( &name );
+    snprintf( host, size, "%s %s %s", name.nodename, name.machine, name.release );
+}
+
+/**
+ * Write 'results' as a baseline file to 'path', creating its directory
+ *
+ * @param  const char *                 path
+ * @param  const struct bench_results * results
+ * @return int
+ */
+static int write_baseline( const char *path, const struct bench_results *results )
+{
+    char directory[ 256 ];
+    char host[ 256 ];
+
+    snprintf( directory, sizeof( directory ), "%s", path );
+    char *slash = strrchr( directory, '/' );
+    if ( slash && slash != directory )
+    {
+        *slash = '\0';
+        mkdir( directory, 0755 );
+    }
+
+    FILE *file = fopen( path, "w" );
+    if ( file == NULL ) return 0;
+
+    host_line( host, sizeof( host ) );
+
+    fprintf( file, "# Benchmark baseline, \"./app compare\" tests new runs against it\n" );
+    fprintf( file, "format=%u\n", BENCH_FORMAT_VERSION );
+    fprintf( file, "suite=%u\n", BENCH_SUITE_VERSION );
+    fprintf( file, "created=%lld\n", (long long)time( NULL ) );
+    fprintf( file, "host=%s\n", host );
+
+    for ( uint i = 0; i < results->series; i++ )
+    {
+        const struct bench_series *series = &results->metric[i];
+
+        fprintf( file, "metric %s %s %u", series->name, series->higher_is_better ? "higher" : "lower", series->count );
+        for ( uint s = 0; s < series->count; s++ ) fprintf( file, " %.1f", series->sample[s] );
+        fprintf( file, "\n" );
+    }
+
+    return fclose( file ) == 0;
+}
+
+/**
+ * Read the baseline file 'path' into 'results', 'host' receives its host line
+ *
+ * @param  const char *           path
+ * @param  struct bench_results * results
+ * @param  char *                 host
+ * @param  size_t                 size
+ * @return int
+ */
+static int read_baseline( const char *path, struct bench_results *results, char *host, size_t size )
+{
+    char line[ 1024 ];
+    uint format = 0, suite = 0;
+
+    FILE *file = fopen( path, "r" );
+    if ( file == NULL )
+    {
+        perror( path );
+        return 0;
+    }
+
+    results->series = 0;
+    host[0] = '\0';
+
+    while ( fgets( line, sizeof( line ), file ) )
+    {
+        line[ strcspn( line, "\n" ) ] = '\0';
+
+        if ( sscanf( line, "format=%u", &format ) == 1 ) continue;
+        if ( sscanf( line, "suite=%u", &suite ) == 1 ) continue;
+        if ( strncmp( line, "host=", 5 ) == 0 )
+        {
+            snprintf( host, size, "%.*s", (int)( size - 1 ), line + 5 );
+            continue;
+        }
+        if ( strncmp( line, "metric ", 7 ) != 0 || results->series == BENCH_MAX_SERIES ) continue;
+
+        struct bench_series *series = &results->metric[ results->series ];
+        char name[ BENCH_NAME_LENGTH ], direction[ 8 ];
+        uint count;
+        int  used;
+
+        if ( sscanf( line, "metric %47s %7s %u%n", name, direction, &count, &used ) != 3 ) continue;
+
+        snprintf( series->name, sizeof( series->name ), "%s", name );
+        series->higher_is_better = strcmp( direction, "higher" ) == 0;
+        series->count = 0;
+
+        for ( char *cursor = line + used, *end; series->count < count && series->count < BENCH_SAMPLES; cursor = end )
+        {
+            double value = strtod( cursor, &end );
+            if ( end == cursor ) break;
+            series->sample[ series->count++ ] = value;
+        }
+
+        results->series++;
+    }
+
+    fclose( file );
+
+    if ( format != BENCH_FORMAT_VERSION || suite != BENCH_SUITE_VERSION )
+    {
+        fprintf( stderr, "%s has format %u suite %u, this build writes format %u suite %u, record a new baseline\n",
+                 path, format, suite, BENCH_FORMAT_VERSION, BENCH_SUITE_VERSION );
+        return 0;
+    }
+
+    return 1;
+}
+
+// -------------------------------------------------------------------
+// -
+// - Statistics
+// -
+// -------------------------------------------------------------------
+
+struct ranked
+{
+    double value;
+    int    group;
+};
+
+static int compare_ranked( const void *a, const void *b )
+{
+    return compare_double( &( (const struct ranked *)a )->value, &( (const struct ranked *)b )->value );
+}
+
+/**
+ * Two-sided Mann-Whitney U test of 'a' against 'b', normal approximation
+ * with tie and continuity correction. Returns the p-value, 1 when every
+ * sample ties
+ *
+ * @param  const struct bench_series * a
+ * @param  const struct bench_series * b
+ * @return double
+ */
+static double mann_whitney( const struct bench_series *a, const struct bench_series *b )
+{
+    struct ranked pooled[ 2 * BENCH_SAMPLES ];
+    uint   n1 = a->count, n2 = b->count, n = n1 + n2;
+    double rank_sum = 0, ties = 0;
+
+    if ( n1 == 0 || n2 == 0 ) return 1;
+
+    for ( uint i = 0; i < n1; i++ ) pooled[i]      = (struct ranked){ a->sample[i], 0 };
+    for ( uint i = 0; i < n2; i++ ) pooled[ n1 + i ] = (struct ranked){ b->sample[i], 1 };
+
+    qsort( pooled, n, sizeof( struct ranked ), compare_ranked );
+
+    // - Equal values share the mean of their ranks
+    for ( uint i = 0; i < n; )
+    {
+        uint j = i;
+        while ( j + 1 < n && pooled[ j + 1 ].value == pooled[i].value ) j++;
+
+        double rank = ( i + j ) / 2.0 + 1;
+        double t    = j - i + 1;
+
+        for ( uint k = i; k <= j; k++ ) if ( pooled[k].group == 0 ) rank_sum += rank;
+
+        ties += t * t * t - t;
+        i = j + 1;
+    }
+
+    double u     = rank_sum - n1 * ( n1 + 1 ) / 2.0;
+    double mean  = n1 * n2 / 2.0;
+    double sigma = sqrt( n1 * n2 / 12.0 * ( ( n + 1 ) - ties / ( (double)n * ( n - 1 ) ) ) );
+
+    if ( sigma == 0 ) return 1;
+
+    double z = ( fabs( u - mean ) - 0.5 ) / sigma;
+    if ( z < 0 ) z = 0;
+
+    return erfc( z / sqrt( 2 ) );
+}
+
+// -------------------------------------------------------------------
+// -
+// - Sub programs
+// -
+// -------------------------------------------------------------------
+
+/**
+ * Run the suite and store it as the baseline 'path'
+ *
+ * @param  const char * path NULL for BENCH_BASELINE_FILE
+ * @return int exit status
+ */
+int bench_baseline( const char *path )
+{
+    static struct bench_results results;
+
+    if ( path == NULL ) path = BENCH_BASELINE_FILE;
+
+    if ( !run_suite( &results ) ) return EXIT_FAILURE;
+
+    for ( uint i = 0; i < results.series; i++ )
+    {
+        printf( "\t%-36s median %14.1f\n", results.metric[i].name, median( &results.metric[i] ) );
+    }
+
+    if ( !write_baseline( path, &results ) ) fail( path );
+
+    printf( "Baseline of %u samples per metric written to %s\n", BENCH_SAMPLES, path );
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * "./app compare [path] [alpha=p] [tolerance=pct] [any-host]"
+ * Rerun the suite and test every metric against the baseline,
+ * exits with EXIT_FAILURE on a regression or an unusable baseline.
+ * The absolute figures of a baseline recorded on another host (or
+ * kernel) say nothing about this one, it is refused without 'any-host'
+ *
+ * @param  int    argc
+ * @param  char * argv[]
+ * @return int exit status
+ */
+int bench_compare( int argc, char *argv[] )
+{
+    static struct bench_results baseline, current;
+    const char *path = BENCH_BASELINE_FILE;
+    double alpha = BENCH_DEFAULT_ALPHA, tolerance = BENCH_DEFAULT_TOLERANCE;
+    char   host[ 256 ], this_host[ 256 ];
+    int    any_host = 0;
+    uint   regressions = 0;
+
+    for ( int i = 2; i < argc; i++ )
+    {
+        if ( strncmp( argv[i], "--", 2 ) == 0 ) continue;
+
+        if ( strncmp( argv[i], "alpha=", 6 ) == 0 )          alpha = strtod( argv[i] + 6, NULL );
+        else if ( strncmp( argv[i], "tolerance=", 10 ) == 0 ) tolerance = strtod( argv[i] + 10, NULL );
+        else if ( strcmp( argv[i], "any-host" ) == 0 )        any_host = 1;
+        else                                                  path = argv[i];
+    }
+
+    if ( !read_baseline( path, &baseline, host, sizeof( host ) ) ) return EXIT_FAILURE;
+
+    host_line( this_host, sizeof( this_host ) );
+
+    if ( strcmp( host, this_host ) != 0 )
+    {
+        fprintf( stderr, "%s: baseline recorded on \"%s\", this is \"%s\"\n", any_host ? "Warning" : "Error", host, this_host );
+        if ( !any_host )
+        {
+            fprintf( stderr, "Record a baseline here with \"make baseline\" or compare anyway with \"./app compare any-host\"\n" );
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf( "Comparing against %s (%s), alpha %.3f, tolerance %.1f%%\n", path, host, alpha, tolerance );
+
+    if ( !run_suite( &current ) ) return EXIT_FAILURE;
+
+    printf( "\n%-36s %14s %14s %9s %9s  %s\n", "Metric", "Baseline", "Current", "Change", "p-value", "Verdict" );
+
+    for ( uint i = 0; i < current.series; i++ )
+    {
+        const struct bench_series *now = &current.metric[i], *before = NULL;
+
+        for ( uint j = 0; j < baseline.series; j++ )
+        {
+            if ( strcmp( baseline.metric[j].name, now->name ) == 0 ) before = &baseline.metric[j];
+        }
+
+        if ( before == NULL )
+        {
+            printf( "%-36s %14s %14.1f %9s %9s  new\n", now->name, "-", median( now ), "-", "-" );
+            continue;
+        }
+
+        double old_median = median( before ), new_median = median( now );
+        double change = old_median != 0 ? ( new_median - old_median ) / old_median * 100 : 0;
+        double p      = mann_whitney( before, now );
+        double worse  = now->higher_is_better ? -change : change;
+
+        const char *verdict = "ok";
+        if ( p < alpha && worse > tolerance )
+        {
+            verdict = "REGRESSION";
+            regressions++;
+        }
+        else if ( p < alpha && worse < -tolerance ) verdict = "improved";
+
+        printf( "%-36s %14.1f %14.1f %+8.1f%% %9.4f  %s\n", now->name, old_median, new_median, change, p, verdict );
+    }
+
+    if ( regressions > 0 )
+    {
+        printf( "\n%u metric(s) regressed\n", regressions );
+        return EXIT_FAILURE;
+    }
+
+    printf( "\nNo regression\n" );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+/* Description:
+ * Benchmark suite with stored baselines and regression detection.
+ * The suite covers the counter update path (inc_counter()), the signal
+ * delivery (sigqueue() / sigwaitinfo() ping-pong with a forked echo process)
+ * and the report generation (print_report() of populated segments into
+ * /dev/null). Every case runs BENCH_SAMPLES times, each sample in a fresh
+ * image of this binary ("./app bench-sample") that sends its metrics and its
+ * peak RSS back over a pipe, so the samples are independent and the memory
+ * use of every case is measured from the same start.
+ * "./app baseline [path]" stores the samples of every metric in a text
+ * file, by default BENCH_BASELINE_FILE next to the Makefile. The file name
+ * carries BENCH_SUITE_VERSION, bump it whenever a case changes what it
+ * measures: the comparison refuses baselines of another suite version.
+ * "./app compare [path] [alpha=p] [tolerance=pct] [any-host]" reruns the
+ * suite and tests every metric against the baseline with a two-sided
+ * Mann-Whitney U test (normal approximation with tie correction). A metric
+ * regresses when the difference is significant at 'alpha' and its median
+ * moved more than 'tolerance' percent in the bad direction, any regression
+ * exits with 1. The figures are absolute: a baseline recorded on another
+ * host (name, machine, kernel) is refused unless 'any-host' is given.
+ * The suite uses the live segment names, do not run it next to a run of
+ * the application.
+ */
+
+#define BENCH_SUITE_VERSION    1
+#define BENCH_FORMAT_VERSION   1
+#define BENCH_BASELINE_FILE    "baselines/suite-v1.baseline"
+#define BENCH_SAMPLES          15
+#define BENCH_MAX_METRICS      4          /* per case, without the peak RSS */
+#define BENCH_MAX_SERIES       32
+#define BENCH_NAME_LENGTH      48
+#define BENCH_DEFAULT_ALPHA    0.01
+#define BENCH_DEFAULT_TOLERANCE 10.0  /* percent */
+
+#define BENCH_COUNTER_OPS      20000
+#define BENCH_ROUND_TRIPS      2000
+#define BENCH_REPORTS          200
+
+struct bench_series
+{
+    char   name[ BENCH_NAME_LENGTH ];
+    int    higher_is_better;
+    uint   count;
+    double sample[ BENCH_SAMPLES ];
+};
+
+struct bench_results
+{
+    uint                series;
+    struct bench_series metric[ BENCH_MAX_SERIES ];
+};
+
+int bench_baseline( const char *path );
+int bench_compare( int argc, char *argv[] );
+int bench_run_sample( const char *index, const char *fd );
+
+#endif /* _BENCH_H_ */
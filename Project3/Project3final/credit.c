@@ -0,0 +1,210 @@
+#include "header.h"
+#include "segment.h"
+#include "credit.h"
+#include "sock_transport.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+struct credits *credits = NULL;
+
+/**
+ * Create the credit pools
+ *
+ * @param  uint window          credits per signal type
+ * @param  uint usr1_receivers  acknowledgements that return one SIGUSR1 credit
+ * @param  uint usr2_receivers  acknowledgements that return one SIGUSR2 credit
+ * @return int
+ */
+int credit_init( uint window, uint usr1_receivers, uint usr2_receivers )
+{
+    credits = segment_create( CREDIT_FILE, sizeof( struct credits ) );
+    if ( credits == NULL ) return 0;
+
+    credits->window    = window;
+    credits->receivers[0] = usr1_receivers ? usr1_receivers : 1;
+    credits->receivers[1] = usr2_receivers ? usr2_receivers : 1;
+    credits->start_ns  = get_timestamp_ns();
+
+    return 1;
+}
+
+/**
+ * Remove the credit file from the os
+ */
+void credit_remove()
+{
+    segment_remove( CREDIT_FILE );
+}
+
+/**
+ * Returns non zero while 'pool' of 'type' has a credit left for one more
+ * event at 'sent' granted events
+ *
+ * @param  struct credit_pool * pool
+ * @param  int                  type
+ * @param  uint64_t             sent
+ * @return int
+ */
+static int credit_available( struct credit_pool *pool, int type, uint64_t sent )
+{
+    uint64_t receipts  = __atomic_load_n( &pool->receipts, __ATOMIC_ACQUIRE );
+    uint64_t reclaimed = __atomic_load_n( &pool->reclaimed, __ATOMIC_ACQUIRE );
+    int64_t  missing   = (int64_t)( sent - reclaimed ) * credits->receivers[ type ] - (int64_t)receipts;
+
+    return missing <= (int64_t)( credits->window - 1 ) * credits->receivers[ type ];
+}
+
+/**
+ * Take a credit for one event of 'type', blocking until the handlers
+ * acknowledged enough of the outstanding ones
+ *
+ * @param int type
+ */
+void credit_acquire( int type )
+{
+    if ( credits == NULL || credits->window == 0 ) return;
+
+    struct credit_pool *pool = &credits->pool[ type ];
+    uint64_t start = 0, waiting_since = 0;
+
+    while ( 1 )
+    {
+        uint64_t sent = __atomic_load_n( &pool->sent, __ATOMIC_ACQUIRE );
+
+        if ( credit_available( pool, type, sent ) )
+        {
+            if ( __atomic_compare_exchange_n( &pool->sent, &sent, sent + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) break;
+            continue;
+        }
+
+        // ----------------------------------------------
+        // - Out of credits, sleep until the next receipt
+        // ----------------------------------------------
+        uint64_t now = get_timestamp_ns();
+
+        if ( start == 0 )
+        {
+            start = waiting_since = now;
+            __atomic_add_fetch( &pool->blocks, 1, __ATOMIC_RELAXED );
+
+            // - The receipts may wait for events still in our batch
+            sock_flush();
+        }
+        else if ( now - waiting_since >= CREDIT_TIMEOUT_US * 1000ull )
+        {
+            // - The acknowledgement got lost, take the credit back
+            __atomic_add_fetch( &pool->reclaimed, 1, __ATOMIC_RELEASE );
+            waiting_since = now;
+            continue;
+        }
+
+        uint32_t wake = __atomic_load_n( &pool->wake, __ATOMIC_ACQUIRE );
+        struct timespec timeout = { 0, 10000000 };
+
+        __atomic_add_fetch( &pool->waiters, 1, __ATOMIC_ACQ_REL );
+        if ( !credit_available( pool, type, __atomic_load_n( &pool->sent, __ATOMIC_ACQUIRE ) ) )
+        {
+            syscall( SYS_futex, &pool->wake, FUTEX_WAIT, wake, &timeout, NULL, 0 );
+        }
+        __atomic_sub_fetch( &pool->waiters, 1, __ATOMIC_ACQ_REL );
+    }
+
+    if ( start ) __atomic_add_fetch( &pool->blocked_ns, get_timestamp_ns() - start, __ATOMIC_RELAXED );
+}
+
+/**
+ * Acknowledge 'count' consumed events of 'type' and wake blocked generators
+ *
+ * @param int  type
+ * @param uint count
+ */
+void credit_release( int type, uint count )
+{
+    if ( credits == NULL || credits->window == 0 ) return;
+
+    struct credit_pool *pool = &credits->pool[ type ];
+    uint64_t receipts = __atomic_load_n( &pool->receipts, __ATOMIC_ACQUIRE );
+    uint64_t updated;
+
+    // - Late receipts of reclaimed credits are dropped, the receipts never
+    // - exceed the acknowledgements owed or they would widen the window
+    do
+    {
+        uint64_t sent      = __atomic_load_n( &pool->sent, __ATOMIC_ACQUIRE );
+        uint64_t reclaimed = __atomic_load_n( &pool->reclaimed, __ATOMIC_ACQUIRE );
+        uint64_t owed      = ( sent - reclaimed ) * credits->receivers[ type ];
+
+        updated = receipts + count < owed ? receipts + count : owed;
+        if ( updated < receipts ) updated = receipts;
+    }
+    while ( !__atomic_compare_exchange_n( &pool->receipts, &receipts, updated, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) );
+
+    __atomic_add_fetch( &pool->wake, 1, __ATOMIC_RELEASE );
+
+    if ( __atomic_load_n( &pool->waiters, __ATOMIC_ACQUIRE ) )
+    {
+        syscall( SYS_futex, &pool->wake, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0 );
+    }
+}
+
+/**
+ * Display the throughput / loss tradeoff of the credit window
+ */
+void credit_print_report()
+{
+    if ( credits == NULL || credits->window == 0 ) return;
+
+    double elapsed = ( get_timestamp_ns() - credits->start_ns ) / 1e9;
+
+    printf( "\tCredit window %u, %u / %u receipts per SIGUSR1 / SIGUSR2 event\n", credits->window, credits->receivers[0], credits->receivers[1] );
+
+    for ( uint type = 0; type < 2; type++ )
+    {
+        struct credit_pool *pool = &credits->pool[ type ];
+        uint64_t expected = pool->sent * credits->receivers[ type ];
+
+        printf( "\t%s: %.1f events/s, blocked %llu times for %llums, timeouts %llu, unacknowledged %.2f%%\n",
+                type == 0 ? "SIGUSR1" : "SIGUSR2",
+                elapsed > 0 ? pool->sent / elapsed : 0.0,
+                (unsigned long long)pool->blocks,
+                (unsigned long long)( pool->blocked_ns / 1000000 ),
+                (unsigned long long)pool->reclaimed,
+                expected ? 100.0 * ( expected - ( pool->receipts < expected ? pool->receipts : expected ) ) / expected : 0.0 );
+    }
+}
+
+/**
+ * Check that receipts arriving after a reclaim leave the window at its
+ * size: two of four broadcast events time out, their receipts come late
+ *
+ * @return int EXIT_FAILURE when the window widened
+ */
+int credit_test()
+{
+    const uint window = 4, receivers = 2;
+    uint granted = 0;
+
+    segment_private = 1;
+    if ( !credit_init( window, receivers, receivers ) ) fail( "credit_init()" );
+
+    struct credit_pool *pool = &credits->pool[0];
+
+    for ( uint i = 0; i < window; i++ ) credit_acquire( 0 );
+
+    // - Two events coalesced and got reclaimed, the two others acknowledged
+    __atomic_add_fetch( &pool->reclaimed, 2, __ATOMIC_RELEASE );
+    credit_release( 0, 2 * receivers );
+
+    // - The reclaimed events were only late
+    credit_release( 0, 2 * receivers );
+
+    while ( granted < 2 * window && credit_available( pool, 0, pool->sent + granted ) ) granted++;
+
+    printf( "Credits after late receipts: %u of a window of %u, %s\n", granted, window, granted == window ? "ok" : "FAILED" );
+
+    credit_remove();
+    credits = NULL;
+    segment_private = 0;
+
+    return granted == window ? EXIT_SUCCESS : EXIT_FAILURE;
+}
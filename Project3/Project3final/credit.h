@@ -0,0 +1,52 @@
+#ifndef _CREDIT_H_
+#define _CREDIT_H_
+
+/* Description:
+ * Credit-based flow control between generators and handlers.
+ * Every signal type has a window of credits. A generator takes one credit
+ * before emitting and blocks on a futex when none is left. Handlers return
+ * a receipt for every event they consume, an event gives its credit back
+ * once each of its receivers (both handlers of the group for the broadcast
+ * transports, one for the deque) acknowledged it.
+ * Signals that coalesced never get acknowledged, a generator blocked longer
+ * than CREDIT_TIMEOUT_US reclaims the credit and counts a timeout. Receipts
+ * beyond the acknowledgements still owed (late ones of a reclaimed credit)
+ * are dropped, they never widen the window beyond its size.
+ * A generator flushes its pending socket batch before it blocks, the
+ * receipts it waits for may be in it.
+ */
+#include <stdint.h>
+
+#define CREDIT_FILE        "/credits"
+#define CREDIT_TIMEOUT_US  200000
+#define DEFAULT_CREDITS    0          /* 0 disables flow control */
+
+struct credit_pool
+{
+    uint64_t sent;         /* events granted a credit */
+    uint64_t receipts;     /* acknowledgements from the handlers */
+    uint64_t reclaimed;    /* credits recovered by a timeout */
+    uint32_t wake;         /* futex word bumped on every receipt */
+    uint32_t waiters;
+    uint64_t blocked_ns;
+    uint64_t blocks;
+};
+
+struct credits
+{
+    uint               window;
+    uint               receivers[ 2 ];  /* acknowledgements per event of each type */
+    uint64_t           start_ns;
+    struct credit_pool pool[ 2 ];
+};
+
+extern struct credits *credits;
+
+int  credit_init( uint window, uint usr1_receivers, uint usr2_receivers );
+void credit_remove();
+void credit_acquire( int type );
+void credit_release( int type, uint count );
+void credit_print_report();
+int  credit_test();
+
+#endif /* _CREDIT_H_ */
@@ -0,0 +1,248 @@
+#include "header.h"
+#include "options.h"
+#include "segment.h"
+#include "work_deque.h"
+#include "elastic.h"
+
+struct elastic_pool *elastic_pool = NULL;
+
+// - Parent side bookkeeping
+static pid_t    slot_pid[ MAX_RX_PROCESSES ];
+static int      slot_event[ MAX_RX_PROCESSES ];   /* log entry awaiting its reaction time */
+static uint64_t slot_since[ MAX_RX_PROCESSES ];   /* when the watermark was first crossed */
+
+/**
+ * Create the shared memory pool state
+ *
+ * @return int
+ */
+int elastic_init()
+{
+    elastic_pool = segment_create( ELASTIC_FILE, sizeof( struct elastic_pool ) );
+
+    for ( uint i = 0; i < MAX_RX_PROCESSES; i++ ) slot_event[i] = -1;
+
+    return elastic_pool != NULL;
+}
+
+/**
+ * Remove the pool file from the os
+ */
+void elastic_remove()
+{
+    segment_remove( ELASTIC_FILE );
+}
+
+/**
+ * Append a scale event to the log, returns its log index
+ *
+ * @param  int  up
+ * @param  uint backlog
+ * @return int
+ */
+static int log_event( int up, uint backlog )
+{
+    int index = elastic_pool->event_count++ % ELASTIC_LOG_SIZE;
+    struct scale_event *event = &elastic_pool->log[ index ];
+
+    event->at_ns       = get_timestamp_ns();
+    event->up          = up;
+    event->handlers    = elastic_pool->handlers;
+    event->backlog     = backlog;
+    event->reaction_ns = 0;
+
+    if ( up ) elastic_pool->scale_ups++;
+    else elastic_pool->scale_downs++;
+
+    return index;
+}
+
+/**
+ * Fork a handler into a free slot, serving the group with the deeper backlog
+ *
+ * @return int slot, -1 when the pool is full
+ */
+static int spawn_handler()
+{
+    int group = work_deque_group_backlog( 1 ) >= work_deque_group_backlog( 0 );
+
+    for ( int slot = 0; slot < MAX_RX_PROCESSES && slot < (int)options.elastic_max; slot++ )
+    {
+        if ( slot_pid[ slot ] != 0 ) continue;
+
+        // - The parent only clears this once the child registered
+        work_deques->deque[ slot ].stats.pid = 0;
+
+        fflush( stdout );
+        pid_t pid = fork();
+        if ( pid == 0 ) signal_handler_loop( group, slot );
+        if ( pid == -1 ) return -1;
+
+        printf( "MAIN: Elastic pool spawned handler %i in slot %i group %i\n", pid, slot, group );
+        slot_pid[ slot ] = pid;
+        elastic_pool->handlers++;
+
+        return slot;
+    }
+
+    return -1;
+}
+
+/**
+ * Ask the most recently spawned live handler to retire
+ *
+ * @return int slot, -1 when there is none
+ */
+static int retire_handler()
+{
+    for ( int slot = MAX_RX_PROCESSES - 1; slot >= 0; slot-- )
+    {
+        if ( slot_pid[ slot ] == 0 || work_deque_retiring( slot ) ) continue;
+
+        work_deque_retire( slot );
+        elastic_pool->handlers--;
+
+        printf( "MAIN: Elastic pool retires handler %i in slot %i\n", slot_pid[ slot ], slot );
+
+        return slot;
+    }
+
+    return -1;
+}
+
+/**
+ * Fork the initial 'min' handlers, alternating the groups
+ */
+void elastic_start()
+{
+    for ( uint i = 0; i < options.elastic_min; i++ )
+    {
+        int group = ( i & 1 ) == 0;
+
+        pid_t pid = fork();
+        if ( pid == 0 ) signal_handler_loop( group, i );
+
+        slot_pid[i] = pid;
+        elastic_pool->handlers++;
+    }
+}
+
+/**
+ * Parent loop: reap children, watch the backlog and scale the pool,
+ * returns when every child process has exited
+ */
+void elastic_run()
+{
+    uint  over = 0, under = 0;
+    uint64_t over_since = 0, under_since = 0;
+    pid_t wpid;
+    int   status;
+
+    while ( 1 )
+    {
+        // ----------------------------------------------
+        // - Reap exited children, a reaped retiree ends
+        // - its scale down event
+        // ----------------------------------------------
+        while ( ( wpid = waitpid( -1, &status, WNOHANG ) ) > 0 )
+        {
+            printf( "\tMAIN: Child %i completed, status: %i\n\n", wpid, status );
+
+            for ( uint slot = 0; slot < MAX_RX_PROCESSES; slot++ )
+            {
+                if ( slot_pid[ slot ] != wpid ) continue;
+
+                if ( slot_event[ slot ] != -1 )
+                {
+                    elastic_pool->log[ slot_event[ slot ] ].reaction_ns = get_timestamp_ns() - slot_since[ slot ];
+                    slot_event[ slot ] = -1;
+                }
+                slot_pid[ slot ] = 0;
+            }
+        }
+
+        if ( wpid == -1 ) return;
+
+        // ----------------------------------------------
+        // - A registered newcomer ends its scale up event
+        // ----------------------------------------------
+        for ( uint slot = 0; slot < MAX_RX_PROCESSES; slot++ )
+        {
+            struct work_stats *stats = &work_deques->deque[ slot ].stats;
+
+            if ( slot_event[ slot ] == -1 || work_deque_retiring( slot ) ) continue;
+            if ( __atomic_load_n( &stats->pid, __ATOMIC_ACQUIRE ) != slot_pid[ slot ] ) continue;
+
+            elastic_pool->log[ slot_event[ slot ] ].reaction_ns = stats->start_ns - slot_since[ slot ];
+            slot_event[ slot ] = -1;
+        }
+
+        // ----------------------------------------------
+        // - Hysteresis: scale only after consecutive polls
+        // - beyond a watermark
+        // ----------------------------------------------
+        uint backlog = work_deque_backlog();
+        uint64_t now = get_timestamp_ns();
+
+        if ( backlog > options.elastic_high )
+        {
+            if ( over++ == 0 ) over_since = now;
+        }
+        else over = 0;
+
+        if ( backlog < options.elastic_low )
+        {
+            if ( under++ == 0 ) under_since = now;
+        }
+        else under = 0;
+
+        if ( over >= ELASTIC_UP_POLLS && elastic_pool->handlers < options.elastic_max )
+        {
+            int slot = spawn_handler();
+            if ( slot != -1 )
+            {
+                slot_event[ slot ] = log_event( 1, backlog );
+                slot_since[ slot ] = over_since;
+            }
+            over = 0;
+        }
+        else if ( under >= ELASTIC_DOWN_POLLS && elastic_pool->handlers > options.elastic_min )
+        {
+            int slot = retire_handler();
+            if ( slot != -1 )
+            {
+                slot_event[ slot ] = log_event( 0, backlog );
+                slot_since[ slot ] = under_since;
+            }
+            under = 0;
+        }
+
+        usleep( ELASTIC_POLL_US );
+    }
+}
+
+/**
+ * Display the pool size and the latest scale events
+ */
+void elastic_print_report()
+{
+    if ( elastic_pool == NULL ) return;
+
+    printf( "\tElastic pool: %u handlers (%u...%u), %u scale ups, %u scale downs\n",
+            elastic_pool->handlers, options.elastic_min, options.elastic_max,
+            elastic_pool->scale_ups, elastic_pool->scale_downs );
+
+    uint count = elastic_pool->event_count;
+    uint first = count > 5 ? count - 5 : 0;
+
+    for ( uint i = first; i < count; i++ )
+    {
+        struct scale_event *event = &elastic_pool->log[ i % ELASTIC_LOG_SIZE ];
+
+        printf( "\t\tScale %s to %u handlers at backlog %u, ",
+                event->up ? "up" : "down", event->handlers, event->backlog );
+
+        if ( event->reaction_ns ) printf( "reaction %lluus\n", (unsigned long long)event->reaction_ns / 1000 );
+        else printf( "in progress\n" );
+    }
+}
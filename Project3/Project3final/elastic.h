@@ -0,0 +1,50 @@
+#ifndef _ELASTIC_H_
+#define _ELASTIC_H_
+
+/* Description:
+ * Elastic handler pool for the deque transport.
+ * The parent polls the total deque depth and forks a handler when the
+ * backlog stays above the high watermark, or retires one when it stays
+ * below the low watermark, within the configured min...max handlers.
+ * The two watermarks and the consecutive poll counts give the hysteresis.
+ * Scale events and their reaction time (first poll past the watermark to
+ * the new handler registering, or to the retired handler being reaped) are
+ * logged in shared memory for the reporter.
+ */
+#include <stdint.h>
+
+#define ELASTIC_FILE         "/elastic-pool"
+#define ELASTIC_POLL_US      100000
+#define ELASTIC_UP_POLLS     2
+#define ELASTIC_DOWN_POLLS   20
+#define ELASTIC_LOG_SIZE     32
+#define DEFAULT_ELASTIC_HIGH 16
+#define DEFAULT_ELASTIC_LOW  2
+
+struct scale_event
+{
+    uint64_t at_ns;
+    int      up;
+    uint     handlers;     /* pool size after the event */
+    uint     backlog;
+    uint64_t reaction_ns;  /* 0 while still in progress */
+};
+
+struct elastic_pool
+{
+    uint               handlers;
+    uint               scale_ups;
+    uint               scale_downs;
+    uint               event_count;
+    struct scale_event log[ ELASTIC_LOG_SIZE ];
+};
+
+extern struct elastic_pool *elastic_pool;
+
+int  elastic_init();
+void elastic_remove();
+void elastic_start();
+void elastic_run();
+void elastic_print_report();
+
+#endif /* _ELASTIC_H_ */
@@ -0,0 +1,215 @@
+#include "header.h"
+#include "options.h"
+#include "segment.h"
+#include "event_seq.h"
+
+#define PICKUP_READY 0
+#define PICKUP_SPIN  1
+#define PICKUP_BLOCK 2
+
+struct event_sequence *event_seq = NULL;
+static uint            spin_allowed = 1;
+
+/**
+ * Create the shared memory event sequence
+ *
+ * @return int
+ */
+int event_seq_init()
+{
+    event_seq = segment_create( EVENT_SEQ_FILE, sizeof( struct event_sequence ) );
+    if ( event_seq == NULL ) return 0;
+
+    return 1;
+}
+
+/**
+ * Remove the event sequence file from the os
+ */
+void event_seq_remove()
+{
+    segment_remove( EVENT_SEQ_FILE );
+}
+
+/**
+ * Maps SIGUSR1 / SIGUSR2 to the event type index 0 / 1
+ *
+ * @param  int signum
+ * @return int
+ */
+int event_type( int signum )
+{
+    return signum == SIGUSR1 ? 0 : 1;
+}
+
+/**
+ * Publish one event of 'type', called by the generators right before
+ * the signal is emitted so a sleeping handler always gets a wake-up
+ *
+ * @param int type
+ */
+void event_seq_publish( int type )
+{
+    if ( event_seq == NULL ) return;
+
+    __atomic_store_n( &event_seq->published_ns[ type ], get_timestamp_ns(), __ATOMIC_RELAXED );
+    __atomic_add_fetch( &event_seq->seq[ type ], 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Prepare the receive state of the handler in 'slot' listening to 'type'
+ *
+ * @param struct spin_state * state
+ * @param int                 type
+ * @param int                 slot
+ */
+void event_seq_start( struct spin_state *state, int type, int slot )
+{
+    memset( state, 0, sizeof( *state ) );
+
+    state->type     = type;
+    state->slot     = slot;
+    state->last_seq = __atomic_load_n( &event_seq->seq[ type ], __ATOMIC_ACQUIRE );
+
+    // - On a single cpu the spinner would only steal the generators' time slice
+    spin_allowed = sysconf( _SC_NPROCESSORS_ONLN ) > 1;
+
+    event_seq->handler[ slot ].pid       = getpid();
+    event_seq->handler[ slot ].budget_us = spin_allowed ? options.spin_max_us : 0;
+}
+
+/**
+ * Adapt the spin budget to the average inter-arrival time of the
+ * last SPIN_WINDOW events. Spinning only pays off when the next event is
+ * expected within the budget, otherwise spin the minimum and block.
+ *
+ * @param struct spin_state * state
+ */
+static void adapt_budget( struct spin_state *state )
+{
+    struct spin_stats *stats = &event_seq->handler[ state->slot ];
+
+    if ( state->arrival_count < SPIN_WINDOW ) return;
+
+    state->arrival_count = 0;
+    if ( !spin_allowed ) return;
+
+    uint avg = get_avg_interval( state->arrivals, SPIN_WINDOW );
+
+    if ( avg > options.spin_max_us ) stats->budget_us = SPIN_MIN_BUDGET_US;
+    else if ( avg * 2 > options.spin_max_us ) stats->budget_us = options.spin_max_us;
+    else stats->budget_us = avg * 2 > SPIN_MIN_BUDGET_US ? avg * 2 : SPIN_MIN_BUDGET_US;
+}
+
+/**
+ * Wait for new events: spin on the sequence for the current budget,
+ * block in sigwait() on 'mask' when the budget runs out.
+ * Returns the amount of new events, 0 on a stale wake-up
+ * (signal of an event already consumed while spinning)
+ *
+ * @param  struct spin_state * state
+ * @param  sigset_t *          mask
+ * @return uint
+ */
+uint event_seq_wait( struct spin_state *state, sigset_t *mask )
+{
+    struct spin_stats *stats = &event_seq->handler[ state->slot ];
+    uint64_t *seq = &event_seq->seq[ state->type ];
+    uint64_t  current;
+    uint64_t  start = get_timestamp_ns();
+    uint64_t  now = start;
+    uint64_t  budget_ns = (uint64_t)stats->budget_us * 1000;
+    int       sig_caught;
+    int       phase = PICKUP_READY;
+
+    // ----------------------------------------------
+    // - Spin phase
+    // ----------------------------------------------
+    while ( ( current = __atomic_load_n( seq, __ATOMIC_ACQUIRE ) ) == state->last_seq )
+    {
+        now = get_timestamp_ns();
+        if ( now - start >= budget_ns || !child_loop )
+        {
+            phase = PICKUP_BLOCK;
+            break;
+        }
+        phase = PICKUP_SPIN;
+        cpu_relax();
+    }
+
+    if ( phase != PICKUP_BLOCK ) now = get_timestamp_ns();
+    stats->spin_ns += now - start;
+
+    // ----------------------------------------------
+    // - Block phase
+    // ----------------------------------------------
+    if ( phase == PICKUP_BLOCK )
+    {
+        sigwait( mask, &sig_caught );
+        current = __atomic_load_n( seq, __ATOMIC_ACQUIRE );
+        now = get_timestamp_ns();
+    }
+
+    uint events = current - state->last_seq;
+    if ( events == 0 ) return 0;
+
+    uint64_t latency = now - __atomic_load_n( &event_seq->published_ns[ state->type ], __ATOMIC_RELAXED );
+
+    // - Events already pending on entry are backlog, neither path gets credit
+    if ( phase == PICKUP_SPIN )
+    {
+        stats->spin_hits += events;
+        stats->spin_latency_ns += latency * events;
+    }
+    else if ( phase == PICKUP_BLOCK )
+    {
+        stats->block_hits += events;
+        stats->block_latency_ns += latency * events;
+    }
+    else
+    {
+        stats->ready_hits += events;
+    }
+
+    state->last_seq = current;
+    state->arrivals[ state->arrival_count++ ] = get_timestamp();
+    adapt_budget( state );
+
+    return events;
+}
+
+/**
+ * Report CPU time burned spinning against the latency saved by
+ * picking events up without a sleep/wake cycle
+ */
+void event_seq_print_report()
+{
+    uint64_t hits = 0, blocks = 0, spin_ns = 0, spin_lat = 0, block_lat = 0;
+
+    if ( event_seq == NULL ) return;
+
+    for ( uint i = 0; i < MAX_RX_PROCESSES; i++ )
+    {
+        struct spin_stats *stats = &event_seq->handler[i];
+        if ( stats->pid == 0 ) continue;
+
+        printf( "\tHandler %i: spin budget %ius, spin hits %llu, blocking wake-ups %llu, backlog %llu\n",
+                stats->pid, stats->budget_us, (unsigned long long)stats->spin_hits,
+                (unsigned long long)stats->block_hits, (unsigned long long)stats->ready_hits );
+
+        hits      += stats->spin_hits;
+        blocks    += stats->block_hits;
+        spin_ns   += stats->spin_ns;
+        spin_lat  += stats->spin_latency_ns;
+        block_lat += stats->block_latency_ns;
+    }
+
+    uint64_t avg_spin  = hits ? spin_lat / hits : 0;
+    uint64_t avg_block = blocks ? block_lat / blocks : 0;
+    uint64_t saved_ns  = avg_block > avg_spin ? ( avg_block - avg_spin ) * hits : 0;
+
+    printf( "\tSpin latency avg: %lluns, blocking latency avg: %lluns\n",
+            (unsigned long long)avg_spin, (unsigned long long)avg_block );
+    printf( "\tCPU burned spinning: %llums, latency saved: %llums\n",
+            (unsigned long long)( spin_ns / 1000000 ), (unsigned long long)( saved_ns / 1000000 ) );
+}
@@ -0,0 +1,56 @@
+#ifndef _EVENT_SEQ_H_
+#define _EVENT_SEQ_H_
+
+/* Description:
+ * Shared memory event sequence for the spin-then-block receive mode.
+ * Generators bump the sequence of the signal type before emitting the
+ * signal, handlers busy-poll the sequence for an adaptive spin budget and
+ * only fall back to sigwait() when nothing arrived in time.
+ */
+#include <signal.h>
+#include <stdint.h>
+
+#define EVENT_SEQ_FILE    "/event-sequence"
+#define EVENT_TYPE_AMOUNT 2
+#define SPIN_WINDOW       10
+
+struct spin_stats
+{
+    pid_t    pid;
+    uint     budget_us;         /* current adaptive spin budget       */
+    uint64_t spin_hits;         /* events picked up while spinning    */
+    uint64_t block_hits;        /* events picked up after sigwait()   */
+    uint64_t ready_hits;        /* events already pending on entry    */
+    uint64_t spin_ns;           /* time burned in the spin loop       */
+    uint64_t spin_latency_ns;   /* publish -> pickup, spin path       */
+    uint64_t block_latency_ns;  /* publish -> pickup, blocking path   */
+};
+
+struct event_sequence
+{
+    uint64_t          seq[ EVENT_TYPE_AMOUNT ];
+    uint64_t          published_ns[ EVENT_TYPE_AMOUNT ];
+    struct spin_stats handler[ MAX_RX_PROCESSES ];
+};
+
+// - Per process receive state, private to one handler
+struct spin_state
+{
+    int      type;
+    int      slot;
+    uint64_t last_seq;
+    uint     arrivals[ SPIN_WINDOW ];
+    uint     arrival_count;
+};
+
+extern struct event_sequence *event_seq;
+
+int  event_seq_init();
+void event_seq_remove();
+int  event_type( int signum );
+void event_seq_publish( int type );
+void event_seq_start( struct spin_state *state, int type, int slot );
+uint event_seq_wait( struct spin_state *state, sigset_t *mask );
+void event_seq_print_report();
+
+#endif /* _EVENT_SEQ_H_ */
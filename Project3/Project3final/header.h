@@ -27,50 +27,116 @@
 #include <sys/shm.h>
 #include <sys/stat.h> 
 #include <sys/time.h>  
+#include <sys/resource.h>
+#include <sys/timerfd.h>
 #include <time.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include "seg_lock.h"
 
-#define SEM_NAME           "/counter-semaphore"
 #define COUNTER_AMOUNT     4
 #define COUNTER_FILE       "/counters"
 #define RX_COUNTER_SIGUSR1 0
 #define RX_COUNTER_SIGUSR2 1
 #define TX_COUNTER_SIGUSR1 2
 #define TX_COUNTER_SIGUSR2 3
+#define COUNTER_FILE_MAGIC   0x52544e43   /* "CNTR" */
+#define COUNTER_FILE_VERSION 2
 #define RUNTIME_IN_SECONDS 30
 #define TX_PROCESS_AMOUNT  3
 #define RX_PROCESS_AMOUNT  4
 #define MAX_GENERATOR_LOOP 100000
+#define MAX_RX_PROCESSES   16
+#define MAX_TX_PROCESSES   16
 #define fail(msg) {\
                     perror(msg);\
                     return EXIT_FAILURE; }
 
+// - Busy-wait hint for spin loops
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined( __aarch64__ )
+#define cpu_relax() __asm__ __volatile__( "yield" ::: "memory" )
+#else
+#define cpu_relax() __asm__ __volatile__( "" ::: "memory" )
+#endif
+
 typedef unsigned int uint;
 
-sem_t *mutex_sem;
-uint   child_loop = 1;
-uint   total_emissions = 0;
+struct report_snapshot
+{
+    uint64_t              at_ns;
+    int                   counter[ COUNTER_AMOUNT ];
+    int                   lock_kind;
+    struct seg_lock_stats lock;               /* of the counters */
+};
+
+struct counter_file
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t lock;
+    uint32_t clean;                           /* last checkpoint at exit */
+    uint64_t generation;                      /* checkpoints written */
+    uint32_t checksum;                        /* of generation and checkpoint */
+    int      checkpoint[ COUNTER_AMOUNT ];
+    int      counter[ COUNTER_AMOUNT ];
+    struct seg_lock update_lock;              /* of the counters, --lock kind */
+};
+
+struct first_event
+{
+    int      done;
+    uint64_t started_ns;
+    long     faults;
+};
+
+struct metric;
+
+extern uint   child_loop;
+extern __thread uint total_emissions;
+extern pid_t  handler_pid[ MAX_RX_PROCESSES ];
+extern int    handler_group[ MAX_RX_PROCESSES ];
 
 // -------------------------------------------
 // - Function declarations
 // -------------------------------------------
 
+int  open_counters( int flags );
+uint32_t counter_checksum( struct counter_file *file );
+int  resume_counters( struct counter_file *file );
 int  init_counters();
 int  inc_counter( int index );
 int  read_counter( int index );
+void checkpoint_counters( int clean );
 void remove_counters();
 void sigusr1_rx_handler( int signum );
 void sigusr2_rx_handler( int signum );
 void sigusr_report_handler( int signum  );
+void observe_latency( uint64_t sent_ns );
+int  signal_sender( siginfo_t *info );
+void write_summary();
+void remove_segments();
 void sigint_handler( int signum );
 uint get_timestamp();
-uint get_vg_interval( uint time_list[], uint count );
+uint64_t get_timestamp_ns();
+uint get_avg_interval( uint time_list[], uint count );
 int  get_sleep_time();
 int  get_random_signum();
-void print_report();
+void do_event_work();
+void signal_name( int signum, char *name, size_t size );
+void register_metrics();
+long get_minor_faults();
+void first_event_begin( struct first_event *first );
+void first_event_end( struct first_event *first, struct metric *latency, struct metric *faults );
+void take_snapshot( struct report_snapshot *snapshot );
+void print_report( struct report_snapshot *previous, struct report_snapshot *current );
 int  report_loop();
-int  signal_handler_loop( int group );
-int  signal_generator_loop();
+int  signal_handler_loop( int group, int slot );
+void emit_signal( int signum, int id, uint32_t seq );
+void emit_event( int source, int signum, uint32_t seq );
+int  signal_generator_loop( int id );
 void srand( unsigned );
 
 
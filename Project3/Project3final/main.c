@@ -7,6 +7,88 @@
 // 
 // "./app reset" forces the application to reset the counters
 //
+// "./app --spin[=max_us]" makes the signal handlers busy-poll a shared
+// event sequence before blocking in sigwait()
+//
+// "./app --transport=socket [--batch=n]" carries the events over unix
+// datagram sockets, n events per sendmmsg() / recvmmsg() call
+//
+// "./app --transport=socket --payload=n[-m]" attaches zero-copy payloads
+// from the shared slab arena to the socket events
+//
+// "./app --transport=deque [--skew=90] [--work=spin:200]" distributes the
+// events over work-stealing handler deques
+//
+// "./app --transport=deque --elastic=1:8" lets the parent fork and retire
+// handlers between 1 and 8 processes following the deque backlog
+//
+// "./app --credits=n" bounds the unacknowledged events per signal type,
+// generators block until the handlers return credits
+//
+// "./app --sequence" numbers every emission per generator and reports
+// loss, duplication and reordering seen by the handlers
+//
+// "./app --report-interval=ms" sets the period of the timer driven report
+//
+// "./app --prefault [--mlock] [--hugepages[=explicit]]" prefaults, locks and
+// backs the shared segments by huge pages in every process
+//
+// "./app --counter-file=path" keeps the counters in a regular file, checkpointed
+// every report and resumed by the next run ("./app reset --counter-file=path"
+// starts it over)
+//
+// "./app --archive=path" appends every report snapshot to a compact time-series
+// archive
+//
+// "./app query path [from [to]]" shows the counter rates of the archive between
+// 'from' and 'to', epoch seconds or "-n" seconds before now / 'to'
+//
+// "./app archive-bench [path]" benchmarks the archive size and range queries
+//
+// "./app --sources=n" runs n virtual sources with their own arrival rates and
+// sequence numbers on a timer wheel in every generator process
+//
+// "./app simulate [--seed=n]" runs the 100'000 emissions on a virtual clock in
+// one process, equal seeds print equal results and digests
+//
+// "./app --threads" runs the generators, handlers and the reporter as threads
+// of one process, signals go to the handler threads with pthread_sigqueue()
+//
+// "./app --uring" receives through io_uring (multishot reads on the handler
+// socket or signalfd) and submits the socket batches through its queue
+//
+// "./app uring-bench" benchmarks the io_uring receive paths against
+// epoll_wait() + recvmmsg() and sigwaitinfo()
+//
+// "./app --lock=mutex|ticket|atomic" guards the counter updates by a robust
+// process-shared mutex, a ticket spinlock or a lock-free compare-and-swap,
+// the report shows the lock contention
+//
+// "./app --generators=n --handlers=m" changes the amount of generating and
+// handling processes, "--summary=path" writes the run results at the end
+//
+// "./app sweep generators=1,2,4 handlers=2,4 sources=0,100 transport=signal,socket
+// counters=shm,file lock=mutex,ticket repeat=3 duration=5 format=csv|json [output=path] [--option...]"
+// runs every cell of the matrix in a fresh process tree and prints one CSV / JSON
+// row per run: throughput, loss, latency percentiles and cpu per event
+//
+// "./app baseline [path]" runs the benchmark suite (inc_counter, signal delivery,
+// report generation) and stores its samples as the baseline, "make baseline"
+//
+// "./app compare [path] [alpha=0.01] [tolerance=10] [any-host]" reruns the suite and
+// exits non-zero on a significant regression against the baseline, "make compare".
+// A baseline of another host is refused unless 'any-host' is given
+//
+// "./app slab-bench" benchmarks the slab arena for payloads of 16 B...64 KiB
+//
+// "./app stats-bench" benchmarks the interval statistics kernels
+//
+// "./app stats-test" checks the vector interval statistics kernels against
+// the scalar one, out of order timestamps included, "make test"
+//
+// "./app credit-test" checks that late receipts of reclaimed credits do not
+// widen the credit window, "make test"
+//
 // otherwise the application creates three processes that emits
 // 100'000 signals total
 // of SIGUSR1 and SIGUSR2
@@ -16,81 +98,243 @@
 //
 
 #include "header.h"
+#include "options.h"
+#include "event_seq.h"
+#include "sock_transport.h"
+#include "slab.h"
+#include "work_deque.h"
+#include "elastic.h"
+#include "credit.h"
+#include "seq_track.h"
+#include "stats.h"
+#include "registry.h"
+#include "segment.h"
+#include "spinlock.h"
+#include "archive.h"
+#include "source_loop.h"
+#include "sim.h"
+#include "threaded.h"
+#include "uring.h"
+#include "sweep.h"
+#include "sender.h"
+#include "bench.h"
+#include <sys/signalfd.h>
+
+uint   child_loop = 1;
+__thread uint total_emissions = 0;
+pid_t  handler_pid[ MAX_RX_PROCESSES ];
+int    handler_group[ MAX_RX_PROCESSES ];
+
+// - Counters of the threaded mode and of the simulation
+static int thread_counter[ COUNTER_AMOUNT ];
+
+// - Registry slots, registered by the parent before the fork
+static struct metric *emitted_metric[ NSIG ];
+static struct metric *received_metric[ NSIG ];
+static struct metric *kill_error_metric;
+static struct metric *sigqueue_error_metric;
+static struct metric *work_push_error_metric;
+static struct metric *handlers_active_metric;
+static struct metric *generators_active_metric;
+static struct metric *sleep_metric;
+static struct metric *batch_metric;
+static struct metric *generator_first_ns_metric;
+static struct metric *generator_first_faults_metric;
+static struct metric *handler_first_ns_metric;
+static struct metric *handler_first_faults_metric;
+static struct metric *latency_metric;
+
+// - The process that forked the roles, writes the --summary
+static pid_t    main_pid;
+static uint64_t main_started_ns;
+
+// - The counter segment, mapped once by init_counters() and inherited by the
+// - forked roles. The mapping outlives the removal of the file on CTRL-C
+static struct counter_file *counters = NULL;
+
+// - Set while this process holds the checkpoint lock or appends to the archive,
+// - a SIGINT meanwhile is only flagged and handled once the section is done
+static volatile sig_atomic_t sigint_deferred = 0;
+static volatile sig_atomic_t sigint_pending = 0;
 
 /**
- * Create the shared memory for counters and initialize them to zero
+ * Open the counter segment, the regular file given by --counter-file
+ * or the shared memory file
  * 
+ * @param  int flags open() flags
+ * @return int file descriptor, -1 on failure
+ */
+int open_counters( int flags )
+{
+    if ( options.counter_file ) return open( options.counter_file, flags, 0666 );
+
+    return shm_open( COUNTER_FILE, flags, 0666 );
+}
+
+/**
+ * Returns the FNV-1a checksum of the checkpointed counters
+ * 
+ * @param  struct counter_file * file
+ * @return uint32_t
+ */
+uint32_t counter_checksum( struct counter_file *file )
+{
+    const unsigned char *byte = (const unsigned char *)&file->generation;
+    uint32_t hash = 2166136261u;
+
+    for ( uint i = 0; i < sizeof( file->generation ); i++ ) hash = ( hash ^ byte[i] ) * 16777619u;
+
+    byte = (const unsigned char *)file->checkpoint;
+    for ( uint i = 0; i < sizeof( file->checkpoint ); i++ ) hash = ( hash ^ byte[i] ) * 16777619u;
+
+    return hash;
+}
+
+/**
+ * Returns whether a file backed counter segment from a previous run can be
+ * resumed, picking the live counters when they are not behind the checksummed
+ * checkpoint and the checkpoint otherwise
+ * 
+ * @param  struct counter_file * file
  * @return int
  */
-int init_counters()
+int resume_counters( struct counter_file *file )
 {
-    printf( "Initializing shared memory for counters\n" );
+    if ( file->magic != COUNTER_FILE_MAGIC || file->version != COUNTER_FILE_VERSION ) return 0;
 
-    int shm_fd = shm_open( COUNTER_FILE, O_CREAT | O_RDWR, 0666 );
-    if ( shm_fd == -1 ) fail( "shm_open()" );
+    if ( file->checksum != counter_checksum( file ) )
+    {
+        fprintf( stderr, "Counter file %s failed the checksum, starting from zero\n", options.counter_file );
+        return 0;
+    }
 
-    int result = ftruncate( shm_fd, COUNTER_AMOUNT );
-    if ( result == -1 ) fail( "ftruncate()" );
+    int live = 1;
 
-    int *counter_address = ( int * ) mmap( 0, COUNTER_AMOUNT, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0 );
- 
     for ( register uint i = 0; i < COUNTER_AMOUNT; i++ )
     {
-        counter_address[i] = 0;
+        if ( file->counter[i] < file->checkpoint[i] ) live = 0;
     }
 
-    munmap( counter_address, COUNTER_AMOUNT) ;
-    close( shm_fd );
+    if ( !live ) memcpy( file->counter, file->checkpoint, sizeof( file->counter ) );
+
+    printf( "Resumed counters from %s, checkpoint %llu, %s shutdown, %s values\n", options.counter_file,
+            (unsigned long long)file->generation, file->clean ? "clean" : "unclean", live ? "live" : "checkpointed" );
+    fflush( stdout );
 
     return 1;
 }
 
 /**
- * Increments the counter specified by the param 'index'
- * Acceptable 'index' value 0...3
+ * Create the shared memory for counters and initialize them to zero,
+ * a valid counter file of a previous run is resumed instead. The segment
+ * is mapped once, the forked roles inherit the mapping
  * 
- * @param  int index
  * @return int
  */
-int inc_counter( int index )
+int init_counters()
 {
-    if ( index < 0 || index >= COUNTER_AMOUNT ) return -1;
+    // - The simulation counts in process memory, a live run keeps its segment
+    if ( sim_active )
+    {
+        memset( thread_counter, 0, sizeof( thread_counter ) );
+        return 1;
+    }
 
-    sem_trywait( mutex_sem );
+    printf( "Initializing shared memory for counters\n" );
+
+    if ( counters ) segment_detach( counters, sizeof( struct counter_file ) );
+    counters = NULL;
 
     // ----------------------------------------------
-    // - Enter critical section
+    // - Map the segment once, prefaulted, locked and
+    // - on huge pages like the other segments
     // ----------------------------------------------
+    struct counter_file *file;
+    int resumable = 0;
 
-    pid_t pid = getpid();
+    if ( options.counter_file )
+    {
+        int fd = open_counters( O_CREAT | O_RDWR );
+        if ( fd == -1 )
+        {
+            perror( "open()" );
+            return 0;
+        }
+
+        struct stat status;
+        resumable = fstat( fd, &status ) == 0 && status.st_size == sizeof( struct counter_file );
+
+        if ( !resumable && ftruncate( fd, sizeof( struct counter_file ) ) == -1 )
+        {
+            perror( "ftruncate()" );
+            close( fd );
+            return 0;
+        }
+
+        file = segment_map_file( fd, sizeof( struct counter_file ) );
+        close( fd );
+    }
+    else file = segment_create( COUNTER_FILE, sizeof( struct counter_file ) );
+
+    if ( file == NULL ) return 0;
 
-    //printf( "\t\tProcess %i ENTERING inc_counter() critical section...\n", pid );
+    int fresh = !resumable || !resume_counters( file );
 
-    int shm_fd = shm_open( COUNTER_FILE, O_RDWR, 0666 );
+    if ( fresh )
+    {
+        memset( file, 0, sizeof( struct counter_file ) );
+
+        file->magic    = COUNTER_FILE_MAGIC;
+        file->version  = COUNTER_FILE_VERSION;
+        file->checksum = counter_checksum( file );
+    }
 
-    if ( shm_fd == -1 ) 
+    // - A resumed lock keeps its statistics unless a dead holder or another --lock left it unusable
+    if ( fresh || !seg_lock_valid( &file->update_lock, options.lock ) )
     {
-        sem_post( mutex_sem );
-        fail( "shm_open()" );
+        if ( !seg_lock_init( &file->update_lock, options.lock ) )
+        {
+            perror( "seg_lock_init()" );
+            return 0;
+        }
     }
 
-    int *counter_address = (int *)mmap( 0, COUNTER_AMOUNT, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0 );
+    // - A checkpoint lock left taken by a process killed inside the checkpoint
+    file->lock  = 0;
+    file->clean = 0;
+    if ( options.counter_file ) msync( file, sizeof( struct counter_file ), MS_SYNC );
 
-    // - Increment the value
+    counters = file;
 
-    ++counter_address[ index ];
-    //printf( "Increment counter %i, updated value: %i\n", index, ++counter_address[index] );
+    return 1;
+}
 
-    munmap( counter_address, COUNTER_AMOUNT );
-    close( shm_fd );
+/**
+ * Increments the counter specified by the param 'index'
+ * Acceptable 'index' value 0...3
+ * 
+ * @param  int index
+ * @return int
+ */
+int inc_counter( int index )
+{
+    if ( index < 0 || index >= COUNTER_AMOUNT ) return -1;
+
+    // - Threads share the address space, no segment needed
+    if ( options.threads || sim_active )
+    {
+        __atomic_fetch_add( &thread_counter[ index ], 1, __ATOMIC_RELAXED );
+        return 1;
+    }
+
+    if ( counters == NULL ) return -1;
 
-    //printf("\t\tProcess %i LEAVING inc_counter() critical section...\n", pid);
- 
     // ----------------------------------------------
-    // - Leave critical section
+    // - Increment the value in the critical section
+    // - of the --lock kind, counted by the lock
     // ----------------------------------------------
 
-    sem_post( mutex_sem );
+    seg_lock_add( &counters->update_lock, &counters->counter[ index ], 1 );
 
     return 1;
 }
@@ -106,28 +350,59 @@ int read_counter( int index )
 {
     if ( index < 0 || index >= COUNTER_AMOUNT ) return -1;
 
-    int shm_fd = shm_open( COUNTER_FILE, O_RDONLY, 0666 );
-    if( shm_fd == -1 )
-    {
-        fail( "shm_open()" );
-    }
+    if ( options.threads || sim_active ) return __atomic_load_n( &thread_counter[ index ], __ATOMIC_RELAXED );
 
-    int *counter_address = (int *)mmap( 0, COUNTER_AMOUNT, PROT_READ, MAP_SHARED, shm_fd, 0 );
-    int result = counter_address[index];
+    if ( counters == NULL ) return -1;
 
-    munmap( counter_address, COUNTER_AMOUNT );
-    close( shm_fd );
+    return __atomic_load_n( &counters->counter[ index ], __ATOMIC_RELAXED );
+}
 
-    return result;
+/**
+ * Copy the live counters of the file backed segment into the checksummed
+ * checkpoint and flush the file with msync(), 'clean' marks the last
+ * checkpoint of the run
+ * 
+ * @param int clean
+ */
+void checkpoint_counters( int clean )
+{
+    struct counter_file *file = counters;
+
+    if ( !options.counter_file || file == NULL ) return;
+
+    // - SIGINT checkpoints too, it is deferred while this process holds the lock
+    sigint_deferred = 1;
+    spin_lock( &file->lock );
+
+    memcpy( file->checkpoint, file->counter, sizeof( file->checkpoint ) );
+    file->generation++;
+    file->checksum = counter_checksum( file );
+    file->clean    = clean;
+
+    spin_unlock( &file->lock );
+    sigint_deferred = 0;
+
+    msync( file, sizeof( struct counter_file ), MS_SYNC );
+
+    if ( sigint_pending ) sigint_handler( SIGINT );
 }
 
 /**
- * Remove the shared memory file from the os
+ * Remove the shared memory file from the os,
+ * a counter file is checkpointed and kept for the next run
  */
 void remove_counters()
 {
+    if ( sim_active ) return;
+
+    if ( options.counter_file )
+    {
+        checkpoint_counters( 1 );
+        return;
+    }
+
     printf( "Remove shared memory file %s\n", COUNTER_FILE );
-    shm_unlink( COUNTER_FILE );
+    segment_remove( COUNTER_FILE );
 }
 
 
@@ -162,6 +437,108 @@ void sigusr_report_handler( int signum  )
     printf("\tProcess %i sigusr handler, signal %i\n", getpid(), signum );
 }
 
+/**
+ * Record the delivery latency of an event sent at 'sent_ns'
+ *
+ * @param uint64_t sent_ns
+ */
+void observe_latency( uint64_t sent_ns )
+{
+    uint64_t now = get_timestamp_ns();
+
+    if ( sent_ns != 0 && sent_ns <= now ) metric_observe( latency_metric, now - sent_ns );
+}
+
+/**
+ * Returns the queued signal value of generator 'id' for 'seq'
+ *
+ * @param  uint     id   generator id, below MAX_TX_PROCESSES
+ * @param  uint32_t seq
+ * @return int
+ */
+static int signal_value( uint id, uint32_t seq )
+{
+    return (int)( ( (uint32_t)id << SEQ_SIGNAL_BITS ) | ( seq & SEQ_SIGNAL_MASK ) );
+}
+
+/**
+ * Returns the sender table slot of the generator that sent the signal
+ * described by 'info'. The generator id of a queued value is exact,
+ * otherwise the pid is looked up, which the generator threads share
+ * with each other
+ *
+ * @param  siginfo_t * info
+ * @return int         slot or SENDER_NONE
+ */
+int signal_sender( siginfo_t *info )
+{
+    if ( info->si_code == SI_QUEUE ) return (uint32_t)info->si_value.sival_int >> SEQ_SIGNAL_BITS;
+
+    if ( options.threads ) return SENDER_NONE;
+
+    return sender_lookup( info->si_pid );
+}
+
+/**
+ * Write the --summary file: the counters, the receptions expected from
+ * the emissions and the delivery latency quantiles
+ */
+void write_summary()
+{
+    static const char *transport[] = { "signal", "socket", "deque" };
+
+    if ( options.summary == NULL ) return;
+
+    FILE *file = fopen( options.summary, "w" );
+    if ( file == NULL )
+    {
+        perror( "fopen()" );
+        return;
+    }
+
+    int counter[ COUNTER_AMOUNT ];
+
+    for ( uint i = 0; i < COUNTER_AMOUNT; i++ )
+    {
+        counter[i] = read_counter( i );
+    }
+
+    // - Broadcast transports deliver to every handler of the group, the deque to one
+    uint64_t emitted_usr1 = counter[ TX_COUNTER_SIGUSR1 ], emitted_usr2 = counter[ TX_COUNTER_SIGUSR2 ];
+    uint64_t expected = options.transport == TRANSPORT_DEQUE ? emitted_usr1 + emitted_usr2
+                      : emitted_usr1 * ( options.handlers / 2 ) + emitted_usr2 * ( ( options.handlers + 1 ) / 2 );
+
+    fprintf( file, "generators=%u\nhandlers=%u\nsources=%u\ntransport=%s\n",
+             options.generators, options.handlers, options.sources, transport[ options.transport ] );
+    fprintf( file, "elapsed_ns=%llu\n", (unsigned long long)( get_timestamp_ns() - main_started_ns ) );
+    fprintf( file, "emitted=%llu\n", (unsigned long long)( emitted_usr1 + emitted_usr2 ) );
+    fprintf( file, "received=%llu\n", (unsigned long long)( counter[ RX_COUNTER_SIGUSR1 ] + counter[ RX_COUNTER_SIGUSR2 ] ) );
+    fprintf( file, "expected=%llu\n", (unsigned long long)expected );
+    fprintf( file, "latency_samples=%lli\n", latency_metric ? (long long)latency_metric->value : 0ll );
+    fprintf( file, "latency_p50_ns=%llu\n", (unsigned long long)metric_quantile( latency_metric, 0.5 ) );
+    fprintf( file, "latency_p90_ns=%llu\n", (unsigned long long)metric_quantile( latency_metric, 0.9 ) );
+    fprintf( file, "latency_p99_ns=%llu\n", (unsigned long long)metric_quantile( latency_metric, 0.99 ) );
+
+    fclose( file );
+}
+
+/**
+ * Remove the counters and every other shared segment from the os
+ */
+void remove_segments()
+{
+    remove_counters();
+    event_seq_remove();
+    slab_remove();
+    work_deque_remove();
+    elastic_remove();
+    credit_remove();
+    seq_track_remove();
+    stats_remove();
+    metrics_remove();
+    sender_remove();
+}
+
 /**
  * SIGINT Callback, resets the counters and stops the child process loops,
  * Sleeps for a second and exits the progarm
@@ -170,7 +547,15 @@ void sigusr_report_handler( int signum  )
  */
 void sigint_handler( int signum )
 {
-    remove_counters();
+    if ( sigint_deferred )
+    {
+        sigint_pending = 1;
+        return;
+    }
+
+    if ( getpid() == main_pid ) write_summary();
+    remove_segments();
+    archive_close();
     child_loop = 0;
     usleep( 1000000 );
     printf("\nExiting\n");
@@ -196,6 +581,22 @@ uint get_timestamp()
     return tv.tv_sec * (uint)1000000 + tv.tv_usec;
 }
 
+/**
+ * Returns a monotonic timestamp in nanoseconds,
+ * the virtual time while simulating
+ * 
+ * @return uint64_t
+ */
+uint64_t get_timestamp_ns()
+{
+    if ( sim_active ) return sim_now_ns;
+
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
 /**
  * Returns the average time interval from a list of timestamps
  * 
@@ -205,7 +606,7 @@ uint get_timestamp()
  */
 uint get_avg_interval( uint time_list[], uint count )
 {
-    if ( count < 1 ) return 0;
+    if ( count < 2 ) return 0;
 
     uint avg = 0;
 
@@ -214,7 +615,7 @@ uint get_avg_interval( uint time_list[], uint count )
         avg += time_list[ i + 1 ] - time_list[ i ];
     }
 
-    return avg / count;
+    return avg / ( count - 1 );
 }
 
 /**
@@ -228,130 +629,361 @@ int get_sleep_time()
 }
 
 /**
- * Returns a random number between 0 and 1
+ * Returns 1 (SIGUSR1) for 'skew' percent of the calls, 0 otherwise
  * 
  * @return int
  */
 int get_random_signum()
 {
-    return rand() % 2;
+    return (uint)( rand() % 100 ) < options.skew;
 }
 
-/**
- * Displays the current time in the terminal
- */
-void print_report( uint sigusr1_avg_us, uint sigusr2_avg_us )
-{
+/**
+ * Performs the configured synthetic per-event work
+ */
+void do_event_work()
+{
+    static __thread unsigned char *memory = NULL;
+
+    if ( options.work == WORK_SPIN )
+    {
+        uint64_t until = get_timestamp_ns() + (uint64_t)options.work_amount * 1000;
+        while ( get_timestamp_ns() < until ) cpu_relax();
+    }
+    else if ( options.work == WORK_TOUCH && options.work_amount > 0 )
+    {
+        if ( memory == NULL && ( memory = malloc( options.work_amount ) ) == NULL ) return;
+
+        // - One write per cache line
+        for ( uint i = 0; i < options.work_amount; i += 64 ) memory[i]++;
+    }
+}
+
+/**
+ * Writes the name of 'signum' to 'name', SIGRTMIN+n for the realtime signals
+ * 
+ * @param int    signum
+ * @param char * name
+ * @param size_t size
+ */
+void signal_name( int signum, char *name, size_t size )
+{
+    if ( signum == SIGUSR1 )       snprintf( name, size, "SIGUSR1" );
+    else if ( signum == SIGUSR2 )  snprintf( name, size, "SIGUSR2" );
+    else if ( signum == SIGRTMIN ) snprintf( name, size, "SIGRTMIN" );
+    else                           snprintf( name, size, "SIGRTMIN+%i", signum - SIGRTMIN );
+}
+
+/**
+ * Register the per signal, per role and error metrics, the children
+ * inherit the slot pointers
+ */
+void register_metrics()
+{
+    char name[ 16 ];
+
+    for ( int signum = 1; signum < NSIG; signum++ )
+    {
+        if ( signum != SIGUSR1 && signum != SIGUSR2 && ( signum < SIGRTMIN || signum > SIGRTMAX ) ) continue;
+
+        signal_name( signum, name, sizeof( name ) );
+        emitted_metric[ signum ]  = metric_register( METRIC_COUNTER, "signal.%s.emitted", name );
+        received_metric[ signum ] = metric_register( METRIC_COUNTER, "signal.%s.received", name );
+    }
+
+    kill_error_metric        = metric_register( METRIC_COUNTER, "error.kill" );
+    sigqueue_error_metric    = metric_register( METRIC_COUNTER, "error.sigqueue" );
+    work_push_error_metric   = metric_register( METRIC_COUNTER, "error.work_push" );
+    handlers_active_metric   = metric_register( METRIC_GAUGE, "role.handler.active" );
+    generators_active_metric = metric_register( METRIC_GAUGE, "role.generator.active" );
+    sleep_metric             = metric_register( METRIC_HISTOGRAM, "generator.sleep_us" );
+    batch_metric             = metric_register( METRIC_HISTOGRAM, "handler.socket_batch" );
+    latency_metric           = metric_register( METRIC_HISTOGRAM, "handler.latency_ns" );
+
+    generator_first_ns_metric     = metric_register( METRIC_HISTOGRAM, "startup.generator.first_event_ns" );
+    generator_first_faults_metric = metric_register( METRIC_HISTOGRAM, "startup.generator.first_event_faults" );
+    handler_first_ns_metric       = metric_register( METRIC_HISTOGRAM, "startup.handler.first_event_ns" );
+    handler_first_faults_metric   = metric_register( METRIC_HISTOGRAM, "startup.handler.first_event_faults" );
+}
+
+/**
+ * Returns the minor page faults taken by this process so far
+ * 
+ * @return long
+ */
+long get_minor_faults()
+{
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+
+    return usage.ru_minflt;
+}
+
+/**
+ * Start measuring the first event of this process
+ * 
+ * @param struct first_event * first
+ */
+void first_event_begin( struct first_event *first )
+{
+    if ( first->done ) return;
+
+    first->started_ns = get_timestamp_ns();
+    first->faults     = get_minor_faults();
+}
+
+/**
+ * Record the latency and the page faults of the first event
+ * into the 'latency' and 'faults' histograms
+ * 
+ * @param struct first_event * first
+ * @param struct metric *      latency
+ * @param struct metric *      faults
+ */
+void first_event_end( struct first_event *first, struct metric *latency, struct metric *faults )
+{
+    if ( first->done ) return;
+
+    first->done = 1;
+    metric_observe( latency, get_timestamp_ns() - first->started_ns );
+    metric_observe( faults, get_minor_faults() - first->faults );
+}
+
+/**
+ * Store the current counter values in 'snapshot'
+ * 
+ * @param struct report_snapshot * snapshot
+ */
+void take_snapshot( struct report_snapshot *snapshot )
+{
+    memset( snapshot, 0, sizeof( struct report_snapshot ) );
+
+    snapshot->at_ns     = get_timestamp_ns();
+    snapshot->lock_kind = options.lock;
+
+    if ( !options.threads && counters == NULL ) return;
+
+    for ( register uint i = 0; i < COUNTER_AMOUNT; i++ )
+    {
+        snapshot->counter[i] = read_counter( i );
+    }
+
+    if ( options.threads ) return;
+
+    snapshot->lock_kind = counters->update_lock.kind;
+    memcpy( &snapshot->lock, &counters->update_lock.stats, sizeof( snapshot->lock ) );
+}
+
+/**
+ * Returns 0 and complains when the deque handlers received more events of
+ * a type than the generators emitted: a deque event reaches one handler
+ * and the snapshot reads the receivers before the generators. Catches
+ * handlers counting the wake-up signals, as a retired elastic one did
+ *
+ * @param  struct report_snapshot * snapshot
+ * @return int
+ */
+static int deque_counters_valid( struct report_snapshot *snapshot )
+{
+    int valid = 1;
+
+    if ( options.transport != TRANSPORT_DEQUE ) return 1;
+
+    for ( uint type = 0; type < 2; type++ )
+    {
+        int received = snapshot->counter[ type == 0 ? RX_COUNTER_SIGUSR1 : RX_COUNTER_SIGUSR2 ];
+        int emitted  = snapshot->counter[ type == 0 ? TX_COUNTER_SIGUSR1 : TX_COUNTER_SIGUSR2 ];
+
+        if ( received <= emitted ) continue;
+
+        printf( "	Counter check FAILED: %s received %i of %i emitted\n", type == 0 ? "SIGUSR1" : "SIGUSR2", received, emitted );
+        valid = 0;
+    }
+
+    return valid;
+}
+
+/**
+ * Displays the current time, the counter totals and their
+ * deltas and rates since the 'previous' snapshot
+ * 
+ * @param struct report_snapshot * previous
+ * @param struct report_snapshot * current
+ */
+void print_report( struct report_snapshot *previous, struct report_snapshot *current )
+{
+    static const int   order[ COUNTER_AMOUNT ] =
+    {
+        TX_COUNTER_SIGUSR1, TX_COUNTER_SIGUSR2, RX_COUNTER_SIGUSR1, RX_COUNTER_SIGUSR2
+    };
+    static const char *name[ COUNTER_AMOUNT ] =
+    {
+        "Generator counter SIGUSR1", "Generator counter SIGUSR2",
+        "Receiver  counter SIGUSR1", "Receiver  counter SIGUSR2"
+    };
+
+    // ---------------------------
+    // - Report the system time
+    // ---------------------------
+
+    time_t now = time( NULL );
+    char*  time_string = ctime( &now );
+
+    time_string[ strlen( time_string ) - 1 ] = '\0';
+
+    double seconds = ( current->at_ns - previous->at_ns ) / 1e9;
+    int    sigusr1_sent = current->counter[ TX_COUNTER_SIGUSR1 ] - previous->counter[ TX_COUNTER_SIGUSR1 ];
+    int    sigusr2_sent = current->counter[ TX_COUNTER_SIGUSR2 ] - previous->counter[ TX_COUNTER_SIGUSR2 ];
+
+    printf( "\tCurrent time: %s, interval %.3fs\n", time_string, seconds );
+
+    printf( "\tAverage interval between SIGUSR1 emissions: %ius\n", sigusr1_sent > 0 ? (uint)( seconds * 1e6 / sigusr1_sent ) : 0 );
+    printf( "\tAverage interval between SIGUSR2 emissions: %ius\n", sigusr2_sent > 0 ? (uint)( seconds * 1e6 / sigusr2_sent ) : 0 );
+
+    // ---------------------------
+    // - Report the counter values
+    // ---------------------------
+
+    for ( register uint i = 0; i < COUNTER_AMOUNT; i++ )
+    {
+        int index = order[i];
+        int delta = current->counter[ index ] - previous->counter[ index ];
+
+        printf( "%s: %i (+%i, %.1f/s)\n", name[i], current->counter[ index ], delta, seconds > 0 ? delta / seconds : 0.0 );
+    }
+
+    // ---------------------------
+    // - Report the counter lock
+    // ---------------------------
+
+    seg_lock_print_report( "Counter lock", current->lock_kind, &current->lock );
+
+    // ---------------------------
+    // - Report the intervals
+    // ---------------------------
+
+    stats_print_report();
+
+    // ---------------------------
+    // - Report the spin receivers
+    // ---------------------------
+
+    if ( options.spin ) event_seq_print_report();
+
     // ---------------------------
-    // - Report the system time
+    // - Report the payload arena
     // ---------------------------
 
-    time_t now = time( NULL );
-    char*  time_string = ctime( &now );
+    slab_print_report();
 
-    time_string[ strlen( time_string ) - 1 ] = '\0';
+    // ---------------------------
+    // - Report the work deques
+    // ---------------------------
+
+    if ( options.transport == TRANSPORT_DEQUE ) work_deque_print_report();
+    if ( options.elastic ) elastic_print_report();
+    deque_counters_valid( current );
 
-    printf( "\tCurrent time: %s\n", time_string );
+    // ---------------------------
+    // - Report the flow control
+    // ---------------------------
 
-    printf( "\tAverage interval between SIGUSR1 emissions: %ius\n", sigusr1_avg_us );
-    printf( "\tAverage interval between SIGUSR2 emissions: %ius\n", sigusr2_avg_us );
+    credit_print_report();
 
     // ---------------------------
-    // - Report the counter values
+    // - Report the sequence gaps
     // ---------------------------
 
-    printf( "Generator counter SIGUSR1: %i\n", read_counter( TX_COUNTER_SIGUSR1 ) );
-    printf( "Generator counter SIGUSR2: %i\n", read_counter( TX_COUNTER_SIGUSR2 ) );
-    printf( "Receiver  counter SIGUSR1: %i\n", read_counter( RX_COUNTER_SIGUSR1 ) );
-    printf( "Receiver  counter SIGUSR2: %i\n", read_counter( RX_COUNTER_SIGUSR2 ) );
+    if ( options.sequence ) seq_track_print_report();
 
-}
+    // ---------------------------
+    // - Report the generators
+    // ---------------------------
+
+    sender_print_report( seconds );
+
+    // ---------------------------
+    // - Report the segment backing
+    // ---------------------------
 
+    segment_print_report();
+
+    // ---------------------------
+    // - Report the named metrics
+    // ---------------------------
 
+    metrics_print_report();
+}
 
 /**
  * Report loop function for the report process
+ * Woken by a timerfd every 'report_interval_ms', never consumes events
  * 
  */ 
 int report_loop()
 {
-    uint counter = 0;
-    int sig_caught;
-    sigset_t mask;
-    uint sigusr1_count = 0;
-    uint sigusr2_count = 0;
-    uint sigusr1_timeval[10], sigusr2_timeval[10]; 
+    struct report_snapshot snapshot[ 2 ];
+    struct itimerspec interval;
+    uint64_t expirations;
+    uint current = 0;
 
-    // ----------------------------------------------------
-    // - Make the process to respod to SIGUSR1 & SIGUSR2
-    // ----------------------------------------------------
+    int timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+    if ( timer_fd == -1 ) fail( "timerfd_create()" );
 
-    sigemptyset( &mask);
-    sigaddset( &mask, SIGUSR1 );
-    sigaddset( &mask, SIGUSR2 );
-    sigprocmask( SIG_BLOCK, &mask, NULL );
+    interval.it_interval.tv_sec  = options.report_interval_ms / 1000;
+    interval.it_interval.tv_nsec = ( options.report_interval_ms % 1000 ) * 1000000l;
+    interval.it_value            = interval.it_interval;
+
+    if ( timerfd_settime( timer_fd, 0, &interval, NULL ) == -1 ) fail( "timerfd_settime()" );
+
+    segment_prefault();
+    if ( options.archive ) archive_open( options.archive );
 
     printf( "\tReport process enters the loop\n" );
 
+    take_snapshot( &snapshot[ current ] );
+
     while( child_loop )
     {
-        sigwait( &mask, &sig_caught );
+        if ( read( timer_fd, &expirations, sizeof( expirations ) ) != sizeof( expirations ) ) continue;
 
-        if ( sig_caught == SIGUSR1 || sig_caught == SIGUSR2 )
-        {
-            // --------------------------------------------------------
-            // - SIGUSR1 Caught, add the timestamp to the list
-            // --------------------------------------------------------
-            if ( sig_caught == SIGUSR1 )
-            {
-                //printf( "\tReporting loop looping, sigusr1 count %i\n", sigusr1_count);
-                sigusr1_timeval[ sigusr1_count++ ] = get_timestamp();
-            }
+        current ^= 1;
+        take_snapshot( &snapshot[ current ] );
+        print_report( &snapshot[ current ^ 1 ], &snapshot[ current ] );
+        checkpoint_counters( 0 );
 
-            // --------------------------------------------------------
-            // - SIGUSR2 Caught, add the timestamp to the list
-            // --------------------------------------------------------
-            if ( sig_caught == SIGUSR2 )
-            {
-                //printf( "\tReporting loop looping, sigusr1 count %i\n", sigusr2_count);
-                sigusr2_timeval[ sigusr2_count++ ] = get_timestamp();
-            }
+        // - archive_close() from the handler would flush a half encoded block
+        sigint_deferred = 1;
+        archive_append( &snapshot[ current ] );
+        sigint_deferred = 0;
 
-            // --------------------------------------------------------
-            // - Ten signals caught, display a report
-            // - And reset the counters
-            // --------------------------------------------------------
-            if ( ++counter > 10 )
-            {
-                
-                print_report
-                (
-                    get_avg_interval( sigusr1_timeval, sigusr1_count ),
-                    get_avg_interval( sigusr2_timeval, sigusr2_count )
-                );
-
-                sigusr1_count = 0;
-                sigusr2_count = 0;
-                counter = 0;
-            }
-        }
+        if ( sigint_pending ) sigint_handler( SIGINT );
     }
 
+    archive_close();
+    close( timer_fd );
     printf( "Report process exited loop\n" );
+    if ( options.threads ) return 1;
     exit( 1 );    
 }
 
 /**
  * Loop function for signal handler processes
- * Param denotes the group
+ * Param denotes the group, slot is the index of the handler
  * 
  * @param  int group
+ * @param  int slot
  * @return int exit success
  */
-int signal_handler_loop( int group )
+int signal_handler_loop( int group, int slot )
 {
     printf( "\tSignal handler %i spawned in group %i\n", getpid(), group );
 
+    struct first_event first = { 0 };
+
+    segment_prefault();
+    metric_add( handlers_active_metric, 1 );
+
     // ----------------------------------------------------
     // - Make the group 1 respond to SIGUSR1 and
     // - And the orher group to SIGUSR2
@@ -374,68 +1006,347 @@ int signal_handler_loop( int group )
     }
 
     // ------------------------------------------------------
-    // - Listen to the signals
+    // - Socket transport: drain the handler socket in batches
+    // -------------------------------------------------------
+    if ( options.transport == TRANSPORT_SOCKET )
+    {
+        struct event events[ SOCK_MAX_BATCH ];
+
+        while( child_loop )
+        {
+            int count = sock_receive( slot, events, options.batch );
+
+            if ( count > 0 ) metric_observe( batch_metric, count );
+
+            first_event_begin( &first );
+
+            for ( int i = 0; i < count; i++ )
+            {
+                observe_latency( events[i].sent_ns );
+                sender_received( sender_lookup( events[i].sender ), events[i].type, events[i].sent_ns );
+                do_event_work();
+                inc_counter( events[i].type == 0 ? RX_COUNTER_SIGUSR1 : RX_COUNTER_SIGUSR2 );
+                metric_add( received_metric[ events[i].type == 0 ? SIGUSR1 : SIGUSR2 ], 1 );
+                credit_release( events[i].type, 1 );
+                seq_track( slot, events[i].source, events[i].type, events[i].seq );
+
+                // - Consume the payload in place and hand the block back
+                if ( events[i].payload != SLAB_NONE )
+                {
+                    slab_checksum( events[i].payload );
+                    slab_release( events[i].payload );
+                }
+            }
+
+            if ( count > 0 ) first_event_end( &first, handler_first_ns_metric, handler_first_faults_metric );
+        }
+    }
+
+    // ------------------------------------------------------
+    // - Deque transport: own deque first, then steal,
+    // - idle handlers recheck the other deques every 1ms
+    // -------------------------------------------------------
+    else if ( options.transport == TRANSPORT_DEQUE )
+    {
+        struct work_item item;
+        struct timespec  idle = { 0, WORK_IDLE_WAIT_NS };
+
+        work_deque_register( slot, group );
+
+        while( child_loop && !work_deque_retiring( slot ) )
+        {
+            if ( !work_take( slot, &item ) )
+            {
+                sigtimedwait( &mask, NULL, &idle );
+                continue;
+            }
+
+            uint64_t started = get_timestamp_ns();
+
+            observe_latency( item.enqueued_ns );
+            sender_received( options.sources ? item.source / options.sources : item.source, item.type, item.enqueued_ns );
+            first_event_begin( &first );
+            do_event_work();
+            inc_counter( item.type == 0 ? RX_COUNTER_SIGUSR1 : RX_COUNTER_SIGUSR2 );
+            metric_add( received_metric[ item.type == 0 ? SIGUSR1 : SIGUSR2 ], 1 );
+            credit_release( item.type, 1 );
+            seq_track( 0, item.source, item.type, item.seq );
+            work_done( slot, &item, started );
+            first_event_end( &first, handler_first_ns_metric, handler_first_faults_metric );
+        }
+
+        work_deque_unregister( slot );
+    }
+
+    // ------------------------------------------------------
+    // - Spin mode: poll the event sequence, block when idle
+    // -------------------------------------------------------
+    else if ( options.spin )
+    {
+        struct spin_state state;
+        int type = group == 1 ? event_type( SIGUSR1 ) : event_type( SIGUSR2 );
+        int index = group == 1 ? RX_COUNTER_SIGUSR1 : RX_COUNTER_SIGUSR2;
+
+        event_seq_start( &state, type, slot );
+
+        while( child_loop )
+        {
+            uint events = event_seq_wait( &state, &mask );
+
+            // - Woken without a new event (interrupted or stopping)
+            if ( events == 0 ) continue;
+
+            observe_latency( stats_latest( type ) );
+            first_event_begin( &first );
+            credit_release( type, events );
+
+            while ( events-- > 0 )
+            {
+                do_event_work();
+                inc_counter( index );
+                metric_add( received_metric[ group == 1 ? SIGUSR1 : SIGUSR2 ], 1 );
+            }
+
+            first_event_end( &first, handler_first_ns_metric, handler_first_faults_metric );
+        }
+    }
+
+    // ------------------------------------------------------
+    // - Listen to the signals. The other modes only get here
+    // - to leave, a retired elastic handler with child_loop
+    // - still set must not count the deque wake-ups
     // -------------------------------------------------------
+    int listen = options.transport == TRANSPORT_SIGNAL && !options.spin;
     int sig_caught;
+    siginfo_t info;
 
-    while( child_loop )
+    // - With --uring a multishot read stays armed on a signalfd of the mask
+    struct uring signal_ring = { .fd = -1 };
+    int signal_fd = -1;
+
+    if ( options.uring && listen )
     {
-        sigwait( &mask, &sig_caught );
+        if ( ( signal_fd = signalfd( -1, &mask, SFD_CLOEXEC ) ) == -1 ||
+             !uring_init( &signal_ring, URING_ENTRIES ) ||
+             !uring_arm_receive( &signal_ring, signal_fd, sizeof( struct signalfd_siginfo ), 0 ) )
+        {
+            uring_close( &signal_ring );
+            if ( signal_fd != -1 ) close( signal_fd );
+            signal_fd = -1;
+        }
+    }
+
+    while( child_loop && listen )
+    {
+        // - The siginfo names the sender, queued signals also carry the generator id and sequence number
+        sig_caught = signal_fd != -1 ? uring_sigwaitinfo( &signal_ring, &info ) : sigwaitinfo( &mask, &info );
+
+        if ( options.sequence && sig_caught > 0 && info.si_code == SI_QUEUE )
+        {
+            uint32_t value = info.si_value.sival_int;
+            seq_track( slot, value >> SEQ_SIGNAL_BITS, event_type( sig_caught ), value & SEQ_SIGNAL_MASK );
+        }
+
+        first_event_begin( &first );
+
+        // - A signal carries no send time, measure from the newest emission of its type
+        if ( ( sig_caught == SIGUSR1 && group == 1 ) || ( sig_caught == SIGUSR2 && group == 0 ) )
+        {
+            observe_latency( stats_latest( event_type( sig_caught ) ) );
+            sender_received( signal_sender( &info ), event_type( sig_caught ), 0 );
+        }
 
         if ( sig_caught == SIGUSR1 && group == 1)
         {
+            credit_release( event_type( SIGUSR1 ), 1 );
+            do_event_work();
             inc_counter( RX_COUNTER_SIGUSR1 );
+            metric_add( received_metric[ SIGUSR1 ], 1 );
             //printf( "\tGroup %i caught SIGUSR1\n", group );
         }
 
         if ( sig_caught == SIGUSR2 && group == 0)
         {
+            credit_release( event_type( SIGUSR2 ), 1 );
+            do_event_work();
             inc_counter( RX_COUNTER_SIGUSR2 );
+            metric_add( received_metric[ SIGUSR2 ], 1 );
             //printf( "\tGroup %i caught SIGUSR2\n", group );
         }
 
+        if ( child_loop ) first_event_end( &first, handler_first_ns_metric, handler_first_faults_metric );
+
     }
 
-    sigprocmask( SIG_UNBLOCK, &mask, NULL );
+    if ( signal_fd != -1 )
+    {
+        uring_close( &signal_ring );
+        close( signal_fd );
+    }
+
+    metric_add( handlers_active_metric, -1 );
     printf( "Signal handler exited the loop\n" );
+    if ( options.threads ) return EXIT_SUCCESS;
+
+    sigprocmask( SIG_UNBLOCK, &mask, NULL );
     exit( EXIT_SUCCESS );
 }
 
+/**
+ * Emit 'signum' to the handlers. With sequence tracking every
+ * handler gets a sigqueue() carrying the generator id and 'seq',
+ * otherwise the whole process group gets a kill()
+ * 
+ * @param int      signum
+ * @param int      id
+ * @param uint32_t seq
+ */
+void emit_signal( int signum, int id, uint32_t seq )
+{
+    if ( options.threads )
+    {
+        thread_signal( signum, signal_value( id, seq ) );
+        return;
+    }
+
+    if ( !options.sequence )
+    {
+        if ( kill( 0, signum ) == -1 ) metric_add( kill_error_metric, 1 );
+        return;
+    }
+
+    union sigval value;
+    value.sival_int = signal_value( id, seq );
+
+    for ( uint slot = 0; slot < MAX_RX_PROCESSES; slot++ )
+    {
+        if ( handler_pid[ slot ] && handler_group[ slot ] == ( signum == SIGUSR1 ) )
+        {
+            if ( sigqueue( handler_pid[ slot ], signum, value ) == -1 ) metric_add( sigqueue_error_metric, 1 );
+        }
+    }
+}
+
+/**
+ * Emit one event of 'signum' numbered 'seq' for 'source' over
+ * the configured transport
+ * 
+ * @param int      source
+ * @param int      signum
+ * @param uint32_t seq
+ */
+void emit_event( int source, int signum, uint32_t seq )
+{
+    credit_acquire( event_type( signum ) );
+    inc_counter( signum == SIGUSR1 ? TX_COUNTER_SIGUSR1 : TX_COUNTER_SIGUSR2 );
+    metric_add( emitted_metric[ signum ], 1 );
+    stats_record( event_type( signum ) );
+    sender_emitted( event_type( signum ) );
+
+    if ( options.transport == TRANSPORT_SOCKET )
+    {
+        int      type    = event_type( signum );
+        uint32_t payload = SLAB_NONE;
+
+        // - Fill the payload in place, only its offset is sent
+        if ( options.payload_max > 0 )
+        {
+            uint length = options.payload_min + rand() % ( options.payload_max - options.payload_min + 1 );
+
+            payload = slab_alloc( length, sock_receivers( type ) );
+            if ( payload != SLAB_NONE ) memset( slab_data( payload ), (unsigned char)total_emissions, length );
+        }
+
+        sock_send( type, payload, source, seq );
+    }
+    else if ( options.transport == TRANSPORT_DEQUE )
+    {
+        // - A full deque (or no handler) drops the event, no receipt
+        // - will return its credit
+        if ( !work_push( event_type( signum ), source, seq ) )
+        {
+            metric_add( work_push_error_metric, 1 );
+            credit_release( event_type( signum ), 1 );
+            return;
+        }
+
+        if ( options.threads ) thread_signal( signum, 0 );
+        else if ( kill( 0, signum ) == -1 ) metric_add( kill_error_metric, 1 );
+    }
+    else
+    {
+        // - A signal value only has room for the generator id, the sources
+        // - of a generator share its sequence numbers there
+        int generator = options.sources ? source / options.sources : source;
+        if ( options.sources ) seq = seq_next( event_type( signum ) );
+
+        event_seq_publish( event_type( signum ) );
+        emit_signal( signum, generator, seq );
+    }
+}
+
 /**
  * Loop function for the signal generator processes
+ * Param is the generator id stamped on the emissions
  * 
- *
+ * @param  int id
+ * @return int exit success
  */
-int signal_generator_loop()
+int signal_generator_loop( int id )
 {
     pid_t pid = getpid();
 
     printf( "\tSignal generator child process %i starts...\n", pid );
 
+    struct first_event first = { 0 };
+
+    segment_prefault();
+    sender_register( id );
+    metric_add( generators_active_metric, 1 );
+
+    // -------------------------------------------------------------
+    // - Event loop mode: one timer wheel multiplexes the sources
+    // --------------------------------------------------------------
+
+    if ( options.sources > 0 ) source_loop( id, options.sources );
+
     // -------------------------------------------------------------
     // - Enter the loop for 30 seconds OR 100'000 signal emissions
     // --------------------------------------------------------------
 
-    while ( total_emissions++ < MAX_GENERATOR_LOOP )
+    else while ( total_emissions++ < MAX_GENERATOR_LOOP )
     {
         // ---------------------------------------------------------
         // - Get the random sleep time
         // ---------------------------------------------------------
-        usleep( get_sleep_time() );
+        int sleep_time = get_sleep_time();
+
+        metric_observe( sleep_metric, sleep_time );
+
+        // - Do not hold a partial socket batch past --batch-delay
+        sock_flush_due( get_timestamp_ns() + sleep_time * 1000ull );
+        usleep( sleep_time );
 
         // ---------------------------------------------------------
         // - Get the random signal number between SIGUSR1 & SIGUSR2
         // ---------------------------------------------------------
-        if ( get_random_signum() )
-        {
-            inc_counter( TX_COUNTER_SIGUSR1 );
-            kill( 0, SIGUSR1 );
-        }
-        else
-        {
-            inc_counter( TX_COUNTER_SIGUSR2 );
-            kill( 0, SIGUSR2 );
-        }
+        int signum = get_random_signum() ? SIGUSR1 : SIGUSR2;
+
+        first_event_begin( &first );
+
+        emit_event( id, signum, seq_next( event_type( signum ) ) );
+
+        first_event_end( &first, generator_first_ns_metric, generator_first_faults_metric );
+    }
+
+    if ( options.transport == TRANSPORT_SOCKET ) sock_transport_close();
+
+    // - The threads get stopped once every generator returned
+    if ( options.threads )
+    {
+        metric_add( generators_active_metric, -1 );
+        printf( "Terminating the generator thread %i\n", id );
+        return EXIT_SUCCESS;
     }
     
     // --------------------------------------------------
@@ -444,6 +1355,7 @@ int signal_generator_loop()
     // --------------------------------------------------
 
     child_loop = 0;
+    metric_add( generators_active_metric, -1 );
 
     // --------------------------------------------------------------
     // - Emit a few SIGUSR1 and SIGUSR2 to ensure the termination
@@ -484,14 +1396,30 @@ int main( int argc, char *argv[] )
     // -
     // - Check here for command line arguments, if found, run special sub program
     // - for 'reset' (Force reset counters)
+    // - 'slab-bench' (Payload arena benchmark)
+    // - 'stats-bench' (Interval statistics benchmark)
+    // - 'stats-test' (Interval statistics kernels against the scalar one)
+    // - 'credit-test' (Credit window after late receipts)
+    // - 'query' (Archive range query)
+    // - 'simulate' (Deterministic virtual clock run)
+    // - 'archive-bench' (Archive size and query benchmark)
+    // - 'uring-bench' (io_uring receive benchmark)
+    // - 'sweep' (Parameter sweep over fresh process trees)
+    // - and 'baseline' / 'compare' / 'bench-sample' (Benchmark suite against its stored baseline)
     // -
     // --------------------------------------------------------------------------------
+    if ( !parse_options( argc, argv ) ) return EXIT_FAILURE;
+
+    main_pid = getpid();
+    main_started_ns = get_timestamp_ns();
+
     if ( argc > 1)
     {
         if ( strcmp( argv[1], "reset" ) == 0 )
         {
             printf( "Attempting to forcefully reset the counter file data\n") ;
             remove_counters();
+            if ( options.counter_file ) unlink( options.counter_file );
             init_counters();
 
             printf( "Counter values:\n" );
@@ -504,6 +1432,66 @@ int main( int argc, char *argv[] )
             return EXIT_SUCCESS;
         }
 
+        if ( strcmp( argv[1], "slab-bench" ) == 0 )
+        {
+            return slab_benchmark();
+        }
+
+        if ( strcmp( argv[1], "stats-bench" ) == 0 )
+        {
+            return stats_benchmark();
+        }
+
+        if ( strcmp( argv[1], "stats-test" ) == 0 )
+        {
+            return stats_test();
+        }
+
+        if ( strcmp( argv[1], "credit-test" ) == 0 )
+        {
+            return credit_test();
+        }
+
+        if ( strcmp( argv[1], "query" ) == 0 && argc > 2 )
+        {
+            return archive_query( argv[2], argc > 3 ? argv[3] : NULL, argc > 4 ? argv[4] : NULL );
+        }
+
+        if ( strcmp( argv[1], "simulate" ) == 0 )
+        {
+            return simulate( options.seed );
+        }
+
+        if ( strcmp( argv[1], "archive-bench" ) == 0 )
+        {
+            return archive_benchmark( argc > 2 ? argv[2] : "/tmp/archive-bench" );
+        }
+
+        if ( strcmp( argv[1], "uring-bench" ) == 0 )
+        {
+            return uring_benchmark();
+        }
+
+        if ( strcmp( argv[1], "sweep" ) == 0 )
+        {
+            return sweep( argc, argv );
+        }
+
+        if ( strcmp( argv[1], "baseline" ) == 0 )
+        {
+            return bench_baseline( argc > 2 && strncmp( argv[2], "--", 2 ) != 0 ? argv[2] : NULL );
+        }
+
+        if ( strcmp( argv[1], "compare" ) == 0 )
+        {
+            return bench_compare( argc, argv );
+        }
+
+        if ( strcmp( argv[1], "bench-sample" ) == 0 && argc > 3 )
+        {
+            return bench_run_sample( argv[2], argv[3] );
+        }
+
     }
 
     // -------------------------------------------------------------------
@@ -518,14 +1506,6 @@ int main( int argc, char *argv[] )
     // -------------------------------------------------------------------
     srand( time( NULL ) );
 
-    // --------------------------------------------------------------------
-    // - Initialize the semaphore
-    // --------------------------------------------------------------------
-    if ( ( mutex_sem = sem_open( SEM_NAME, O_CREAT, 0666, 0 ) ) == SEM_FAILED )
-    {
-        fail( "sem_open()" );
-    }
-
     // --------------------------------------------------------------------
     // - Create a signal mask for the main process
     // --------------------------------------------------------------------
@@ -535,13 +1515,93 @@ int main( int argc, char *argv[] )
     sigprocmask( SIG_BLOCK, &mask, &oldmask );
 
 
+    // - Reject the unsupported thread combinations before any segment exists
+    if ( options.threads && ( options.transport == TRANSPORT_SOCKET || options.spin || options.elastic ) )
+    {
+        fprintf( stderr, "Threads support the signal and deque transports without --spin and --elastic\n" );
+        return EXIT_FAILURE;
+    }
+    if ( options.threads && options.counter_file )
+    {
+        fprintf( stderr, "Threads keep the counters in process memory, --counter-file needs the forked roles\n" );
+        return EXIT_FAILURE;
+    }
+
     // -------------------------------------------------------------------
     // - Create the shared memory and intializing its value
     // -------------------------------------------------------------------
     printf( "MAIN: Creating the shared memory file for counters\n\n\n" );
-    init_counters();
+    if ( !init_counters() ) return EXIT_FAILURE;
+
+    if ( options.spin && !event_seq_init() ) fail( "event_seq_init()" );
+
+    if ( options.payload_max > 0 )
+    {
+        if ( options.transport != TRANSPORT_SOCKET )
+        {
+            fprintf( stderr, "Payloads need --transport=socket\n" );
+            return EXIT_FAILURE;
+        }
+        if ( !slab_init() ) fail( "slab_init()" );
+    }
+
+    if ( options.transport == TRANSPORT_DEQUE && !work_deque_init() ) fail( "work_deque_init()" );
+
+    if ( options.elastic )
+    {
+        if ( options.transport != TRANSPORT_DEQUE )
+        {
+            fprintf( stderr, "The elastic pool needs --transport=deque\n" );
+            return EXIT_FAILURE;
+        }
+        if ( !elastic_init() ) fail( "elastic_init()" );
+    }
+
+    // - Every handler of the group acknowledges a broadcast event, one handler a deque item,
+    // - with an odd amount of handlers the SIGUSR2 group has the extra one
+    if ( options.credits > 0 )
+    {
+        int  deque = options.transport == TRANSPORT_DEQUE;
+        uint usr1  = deque ? 1 : options.handlers / 2;
+        uint usr2  = deque ? 1 : ( options.handlers + 1 ) / 2;
+
+        if ( !credit_init( options.credits, usr1, usr2 ) ) fail( "credit_init()" );
+    }
+
+    if ( options.sequence && !seq_track_init() ) fail( "seq_track_init()" );
+
+    if ( options.uring && !uring_supported() )
+    {
+        printf( "io_uring is not available, falling back to the plain system calls\n" );
+        options.uring = 0;
+    }
+
+    if ( !stats_init( options.stats_window ) ) fail( "stats_init()" );
+
+    if ( !metrics_init() ) fail( "metrics_init()" );
+    register_metrics();
+
+    if ( !sender_init() ) fail( "sender_init()" );
+
+    // -------------------------------------------------------------------
+    // - The socket transport binds one socket per handler before the
+    // - fork, so every generator can address them
+    // -------------------------------------------------------------------
+    if ( options.transport == TRANSPORT_SOCKET ) sock_transport_init();
+
+
 
+    // -------------------------------------------------------------------
+    // - Threaded mode: the same roles as threads of this process
+    // -------------------------------------------------------------------
+    if ( options.threads )
+    {
+        run_threads();
+        write_summary();
+        remove_segments();
 
+        return 1;
+    }
 
     // -------------------------------------------------------------------
     // - Create the reporting process
@@ -551,27 +1611,38 @@ int main( int argc, char *argv[] )
 
 
     // -------------------------------------------------------------------
-    // - Create the four signal handler processes
+    // - Create the signal handler processes, four by default
     // -------------------------------------------------------------------
-    printf( "Spawning the four signal handling processes\n\n" );
-    process = RX_PROCESS_AMOUNT;
+    printf( "Spawning the %u signal handling processes\n\n", options.handlers );
+    process = options.elastic ? 0 : options.handlers;
+
+    if ( options.elastic ) elastic_start();
 
     while ( process-- > 0 )
     {
-        printf( "Creating signal handler process %i type %i\n", RX_PROCESS_AMOUNT - process, process & 1 );
-        if ( fork() == 0 ) signal_handler_loop( process & 1 );
+        int slot = options.handlers - process - 1;
+
+        printf( "Creating signal handler process %i type %i\n", options.handlers - process, process & 1 );
+
+        if ( options.transport == TRANSPORT_SOCKET && sock_transport_open_handler( slot, process & 1 ) != 0 )
+        {
+            return EXIT_FAILURE;
+        }
+
+        if ( ( handler_pid[ slot ] = fork() ) == 0 ) signal_handler_loop( process & 1, slot );
+        handler_group[ slot ] = process & 1;
     }
 
     // -------------------------------------------------------------------
-    // - Create the three signal generator processes
+    // - Create the signal generator processes, three by default
     // -------------------------------------------------------------------
-    printf( "Spawning the three signal generating processes\n\n" );
-    process = TX_PROCESS_AMOUNT;
+    printf( "Spawning the %u signal generating processes\n\n", options.generators );
+    process = options.generators;
 
     while ( process-- > 0 )
     {
-        printf( "Creating signal generator process %i\n", TX_PROCESS_AMOUNT - process );
-        if ( fork() == 0 ) signal_generator_loop();
+        printf( "Creating signal generator process %i\n", options.generators - process );
+        if ( fork() == 0 ) signal_generator_loop( options.generators - process - 1 );
     }
 
     // -------------------------------------------------------------------
@@ -581,6 +1652,9 @@ int main( int argc, char *argv[] )
     pid_t wpid;
     int status = 0;
 
+    // - The elastic pool keeps scaling the handlers until every child exited
+    if ( options.elastic ) elastic_run();
+
     while( ( wpid = wait( &status ) ) > 0 )
     {
         printf( "\tMAIN: Child %i completed, status: %i\n\n", wpid, status );
@@ -588,7 +1662,8 @@ int main( int argc, char *argv[] )
 
     printf( "MAIN: All child processes completed, main %i\n\n", getpid() );
 
-    remove_counters();
+    write_summary();
+    remove_segments();
 
     return 1;
 }
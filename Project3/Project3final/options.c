@@ -0,0 +1,259 @@
+#include "header.h"
+#include "options.h"
+#include "sock_transport.h"
+#include "slab.h"
+#include "elastic.h"
+#include "credit.h"
+#include "stats.h"
+#include "sim.h"
+#include "seg_lock.h"
+#include "seq_track.h"
+
+struct app_options options =
+{
+    .spin               = 0,
+    .spin_max_us        = DEFAULT_SPIN_MAX_US,
+    .transport          = TRANSPORT_SIGNAL,
+    .batch              = DEFAULT_SOCK_BATCH,
+    .batch_delay_us     = DEFAULT_SOCK_BATCH_DELAY_US,
+    .skew               = 50,
+    .work               = WORK_NONE,
+    .elastic            = 0,
+    .elastic_high       = DEFAULT_ELASTIC_HIGH,
+    .elastic_low        = DEFAULT_ELASTIC_LOW,
+    .credits            = DEFAULT_CREDITS,
+    .sequence           = 0,
+    .report_interval_ms = DEFAULT_REPORT_INTERVAL_MS,
+    .stats_window       = DEFAULT_STATS_WINDOW,
+    .prefault           = 0,
+    .mlock              = 0,
+    .hugepages          = HUGEPAGES_NONE,
+    .counter_file       = NULL,
+    .archive            = NULL,
+    .sources            = 0,
+    .seed               = SIM_DEFAULT_SEED,
+    .threads            = 0,
+    .uring              = 0,
+    .generators         = TX_PROCESS_AMOUNT,
+    .handlers           = RX_PROCESS_AMOUNT,
+    .summary            = NULL,
+    .lock               = SEG_LOCK_MUTEX,
+};
+
+/**
+ * Returns the value part of a "--name=value" argument,
+ * NULL when the argument does not match 'name'
+ *
+ * @param  const char * arg
+ * @param  const char * name
+ * @return const char *
+ */
+static const char *option_value( const char *arg, const char *name )
+{
+    size_t length = strlen( name );
+
+    if ( strncmp( arg, name, length ) != 0 ) return NULL;
+    if ( arg[ length ] == '\0' ) return "";
+    if ( arg[ length ] == '=' ) return arg + length + 1;
+
+    return NULL;
+}
+
+/**
+ * Parse the "--option" style command line arguments into 'options'
+ * Arguments not starting with "--" are left for the sub programs
+ *
+ * @param  int     argc
+ * @param  char ** argv
+ * @return int     1 on success, 0 on an unknown option
+ */
+int parse_options( int argc, char *argv[] )
+{
+    const char *value;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strncmp( argv[i], "--", 2 ) != 0 ) continue;
+
+        if ( ( value = option_value( argv[i], "--spin" ) ) )
+        {
+            options.spin = 1;
+            if ( *value ) options.spin_max_us = strtoul( value, NULL, 10 );
+        }
+        else if ( ( value = option_value( argv[i], "--transport" ) ) )
+        {
+            if ( strcmp( value, "signal" ) == 0 ) options.transport = TRANSPORT_SIGNAL;
+            else if ( strcmp( value, "socket" ) == 0 ) options.transport = TRANSPORT_SOCKET;
+            else if ( strcmp( value, "deque" ) == 0 ) options.transport = TRANSPORT_DEQUE;
+            else
+            {
+                fprintf( stderr, "Unknown transport %s\n", value );
+                return 0;
+            }
+        }
+        else if ( ( value = option_value( argv[i], "--batch-delay" ) ) && *value )
+        {
+            options.batch_delay_us = strtoul( value, NULL, 10 );
+        }
+        else if ( ( value = option_value( argv[i], "--batch" ) ) && *value )
+        {
+            options.batch = strtoul( value, NULL, 10 );
+        }
+        else if ( ( value = option_value( argv[i], "--payload" ) ) && *value )
+        {
+            char *end;
+            options.payload_min = options.payload_max = strtoul( value, &end, 10 );
+            if ( *end == '-' ) options.payload_max = strtoul( end + 1, NULL, 10 );
+
+            if ( options.payload_max < options.payload_min || options.payload_max > SLAB_MAX_PAYLOAD )
+            {
+                fprintf( stderr, "Payload size must be within 0...%i\n", SLAB_MAX_PAYLOAD );
+                return 0;
+            }
+        }
+        else if ( ( value = option_value( argv[i], "--skew" ) ) && *value )
+        {
+            options.skew = strtoul( value, NULL, 10 );
+            if ( options.skew > 100 ) options.skew = 100;
+        }
+        else if ( ( value = option_value( argv[i], "--work" ) ) && *value )
+        {
+            if ( strncmp( value, "spin:", 5 ) == 0 ) options.work = WORK_SPIN;
+            else if ( strncmp( value, "touch:", 6 ) == 0 ) options.work = WORK_TOUCH;
+            else
+            {
+                fprintf( stderr, "Unknown work kind %s\n", value );
+                return 0;
+            }
+            options.work_amount = strtoul( strchr( value, ':' ) + 1, NULL, 10 );
+        }
+        else if ( ( value = option_value( argv[i], "--elastic" ) ) && *value )
+        {
+            options.elastic = 1;
+            if ( sscanf( value, "%u:%u:%u:%u", &options.elastic_min, &options.elastic_max,
+                         &options.elastic_high, &options.elastic_low ) < 2
+                 || options.elastic_min < 1 || options.elastic_min > options.elastic_max
+                 || options.elastic_max > MAX_RX_PROCESSES )
+            {
+                fprintf( stderr, "Elastic pool needs 1 <= min <= max <= %i\n", MAX_RX_PROCESSES );
+                return 0;
+            }
+        }
+        else if ( ( value = option_value( argv[i], "--report-interval" ) ) && *value )
+        {
+            options.report_interval_ms = strtoul( value, NULL, 10 );
+            if ( options.report_interval_ms == 0 ) options.report_interval_ms = 1;
+        }
+        else if ( ( value = option_value( argv[i], "--stats-window" ) ) && *value )
+        {
+            options.stats_window = strtoul( value, NULL, 10 );
+        }
+        else if ( option_value( argv[i], "--sequence" ) )
+        {
+            options.sequence = 1;
+        }
+        else if ( ( value = option_value( argv[i], "--credits" ) ) && *value )
+        {
+            options.credits = strtoul( value, NULL, 10 );
+        }
+        else if ( ( value = option_value( argv[i], "--counter-file" ) ) && *value )
+        {
+            options.counter_file = value;
+        }
+        else if ( ( value = option_value( argv[i], "--sources" ) ) && *value )
+        {
+            options.sources = strtoul( value, NULL, 10 );
+        }
+        else if ( option_value( argv[i], "--threads" ) )
+        {
+            options.threads = 1;
+        }
+        else if ( option_value( argv[i], "--uring" ) )
+        {
+            options.uring = 1;
+        }
+        else if ( ( value = option_value( argv[i], "--generators" ) ) && *value )
+        {
+            options.generators = strtoul( value, NULL, 10 );
+            if ( options.generators < 1 || options.generators > MAX_TX_PROCESSES )
+            {
+                fprintf( stderr, "Generators must be within 1...%i\n", MAX_TX_PROCESSES );
+                return 0;
+            }
+        }
+        else if ( ( value = option_value( argv[i], "--handlers" ) ) && *value )
+        {
+            options.handlers = strtoul( value, NULL, 10 );
+            if ( options.handlers < 2 || options.handlers > MAX_RX_PROCESSES )
+            {
+                fprintf( stderr, "Handlers must be within 2...%i\n", MAX_RX_PROCESSES );
+                return 0;
+            }
+        }
+        else if ( ( value = option_value( argv[i], "--summary" ) ) && *value )
+        {
+            options.summary = value;
+        }
+        else if ( ( value = option_value( argv[i], "--lock" ) ) && *value )
+        {
+            if ( strcmp( value, "mutex" ) == 0 ) options.lock = SEG_LOCK_MUTEX;
+            else if ( strcmp( value, "ticket" ) == 0 ) options.lock = SEG_LOCK_TICKET;
+            else if ( strcmp( value, "atomic" ) == 0 ) options.lock = SEG_LOCK_ATOMIC;
+            else
+            {
+                fprintf( stderr, "Unknown lock %s\n", value );
+                return 0;
+            }
+        }
+        else if ( ( value = option_value( argv[i], "--seed" ) ) && *value )
+        {
+            options.seed = strtoull( value, NULL, 10 );
+        }
+        else if ( ( value = option_value( argv[i], "--archive" ) ) && *value )
+        {
+            options.archive = value;
+        }
+        else if ( option_value( argv[i], "--prefault" ) )
+        {
+            options.prefault = 1;
+        }
+        else if ( option_value( argv[i], "--mlock" ) )
+        {
+            options.mlock = 1;
+        }
+        else if ( ( value = option_value( argv[i], "--hugepages" ) ) )
+        {
+            if ( *value == '\0' || strcmp( value, "transparent" ) == 0 ) options.hugepages = HUGEPAGES_TRANSPARENT;
+            else if ( strcmp( value, "explicit" ) == 0 ) options.hugepages = HUGEPAGES_EXPLICIT;
+            else
+            {
+                fprintf( stderr, "Unknown huge page kind %s\n", value );
+                return 0;
+            }
+        }
+        else
+        {
+            fprintf( stderr, "Unknown option %s\n", argv[i] );
+            return 0;
+        }
+    }
+
+    // - The socket and deque events carry the source id, every source is a tracked stream
+    if ( options.sequence && options.sources && options.transport != TRANSPORT_SIGNAL
+         && options.generators * options.sources > SEQ_MAX_SOURCES )
+    {
+        fprintf( stderr, "--sequence tracks at most %i sources (generators x sources) over the %s transport\n",
+                 SEQ_MAX_SOURCES, options.transport == TRANSPORT_SOCKET ? "socket" : "deque" );
+        return 0;
+    }
+
+    // - The spin handlers consume counts of the event sequence, not events
+    if ( options.spin && ( options.transport != TRANSPORT_SIGNAL || options.sequence ) )
+    {
+        fprintf( stderr, "--spin only replaces sigwait() of the signal transport and carries no sequence numbers, not with %s\n",
+                 options.sequence ? "--sequence" : "--transport=socket / deque" );
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,127 @@
+#ifndef _OPTIONS_H_
+#define _OPTIONS_H_
+
+/* Description:
+ * Command line options shared by all the processes.
+ * Parsed once by the parent, the child processes inherit them through fork().
+ *
+ *  --spin[=max_us]   Handlers busy-poll the shared event sequence before
+ *                    falling back to sigwait(), the spin budget adapts to the
+ *                    observed inter-arrival time up to 'max_us'. Signal
+ *                    transport only, not with --sequence
+ *  --transport=name  Event transport: "signal" (default), "socket" or
+ *                    "deque" (work-stealing deques, signals as wake-up)
+ *  --batch=n         Events per sendmmsg() / recvmmsg() call of the
+ *                    socket transport
+ *  --batch-delay=us  Longest wait of an event in a partial socket batch, a
+ *                    generator sends the batch before sleeping past it
+ *  --payload=n[-m]   Attach a payload of n bytes (or a random size in n...m)
+ *                    from the shared slab arena to every socket event
+ *  --skew=p          Percentage of the emissions that are SIGUSR1
+ *  --work=kind:n     Synthetic work per received event, "spin:us" burns cpu
+ *                    for n microseconds, "touch:bytes" writes n bytes of memory
+ *  --elastic=min:max[:high:low]
+ *                    Deque transport only: scale the handler pool between min
+ *                    and max processes on the backlog watermarks high / low
+ *  --credits=n       Credit window per signal type, generators block when
+ *                    n events are not yet acknowledged by the handlers
+ *  --sequence        Track per generator sequence numbers in the handlers and
+ *                    report loss, duplication and reordering. The signal
+ *                    transport then uses sigqueue() instead of kill()
+ *  --report-interval=ms
+ *                    Period of the timer driven report
+ *  --stats-window=n  Emission timestamps kept per signal type for the
+ *                    interval statistics
+ *  --prefault        Populate the shared segments in every process up front
+ *  --mlock           Lock the shared segments in memory
+ *  --counter-file=path
+ *                    Keep the counters in a regular file with a versioned and
+ *                    checksummed header, checkpointed with msync() on every
+ *                    report and resumed by the next run, not with --threads
+ *  --sources=n       Every generator multiplexes n virtual sources on a timer
+ *                    wheel instead of sleeping between emissions. With
+ *                    --sequence the socket and deque transports track every
+ *                    source, at most SEQ_MAX_SOURCES over all generators
+ *  --threads         Run the roles as threads of one process instead of
+ *                    forked processes (signal and deque transports)
+ *  --seed=n          Random seed of the 'simulate' sub program
+ *  --archive=path    Append the counter snapshot of every report to a
+ *                    time-series archive, see the 'query' sub program
+ *  --hugepages[=kind]
+ *                    Back the shared segments by "transparent" (default) or
+ *                    "explicit" hugetlbfs huge pages when available
+ *  --generators=n    Generator processes (threads), 1...MAX_TX_PROCESSES
+ *  --handlers=n      Handler processes (threads), 2...MAX_RX_PROCESSES. The
+ *                    groups alternate down from the last slot, which serves
+ *                    SIGUSR2: slot i (from 0) serves SIGUSR1 when n - 1 - i
+ *                    is odd, so n / 2 handlers serve SIGUSR1 and the rest
+ *                    SIGUSR2
+ *  --summary=path    Write a "key=value" summary of the run when it ends or
+ *                    gets interrupted, read back by the 'sweep' sub program
+ *  --uring           Receive through io_uring: multishot recv on the handler
+ *                    socket or multishot read on a signalfd, generators submit
+ *                    socket batches as linked SENDMSG requests. Falls back to
+ *                    the plain system calls when the kernel lacks io_uring
+ *  --lock=kind       Lock of the counter updates: "mutex" (default, robust
+ *                    process-shared), "ticket" (spinlock) or "atomic"
+ *                    (lock-free compare-and-swap), see seg_lock.h
+ */
+
+#define DEFAULT_SPIN_MAX_US 1000
+#define SPIN_MIN_BUDGET_US  2
+
+#define DEFAULT_REPORT_INTERVAL_MS 1000
+
+#define TRANSPORT_SIGNAL    0
+#define TRANSPORT_SOCKET    1
+#define TRANSPORT_DEQUE     2
+
+#define WORK_NONE           0
+#define WORK_SPIN           1
+#define WORK_TOUCH          2
+
+#define HUGEPAGES_NONE        0
+#define HUGEPAGES_TRANSPARENT 1
+#define HUGEPAGES_EXPLICIT    2
+
+struct app_options
+{
+    int  spin;
+    uint spin_max_us;
+    int  transport;
+    uint batch;
+    uint batch_delay_us;
+    uint payload_min;
+    uint payload_max;
+    uint skew;
+    int  work;
+    uint work_amount;
+    int  elastic;
+    uint elastic_min;
+    uint elastic_max;
+    uint elastic_high;
+    uint elastic_low;
+    uint credits;
+    int  sequence;
+    uint report_interval_ms;
+    uint stats_window;
+    int  prefault;
+    int  mlock;
+    int  hugepages;
+    const char *counter_file;
+    const char *archive;
+    uint sources;
+    uint64_t seed;
+    int  threads;
+    int  uring;
+    uint generators;
+    uint handlers;
+    const char *summary;
+    int  lock;
+};
+
+extern struct app_options options;
+
+int parse_options( int argc, char *argv[] );
+
+#endif /* _OPTIONS_H_ */
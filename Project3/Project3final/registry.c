@@ -0,0 +1,184 @@
+#include <stdarg.h>
+#include "header.h"
+#include "segment.h"
+#include "registry.h"
+
+#define SLOT_EMPTY   0
+#define SLOT_CLAIMED 1
+#define SLOT_READY   2
+
+struct metric_registry *metric_registry = NULL;
+
+/**
+ * Create the shared memory registry
+ *
+ * @return int
+ */
+int metrics_init()
+{
+    metric_registry = segment_create( METRICS_FILE, sizeof( struct metric_registry ) );
+
+    return metric_registry != NULL;
+}
+
+/**
+ * Remove the registry file from the os
+ */
+void metrics_remove()
+{
+    segment_remove( METRICS_FILE );
+}
+
+/**
+ * FNV-1a hash of a metric name
+ *
+ * @param  const char * name
+ * @return uint32_t
+ */
+static uint32_t hash_name( const char *name )
+{
+    uint32_t hash = 2166136261u;
+
+    while ( *name ) hash = ( hash ^ (unsigned char)*name++ ) * 16777619u;
+
+    return hash;
+}
+
+/**
+ * Returns the slot of the metric named after 'format', registering it
+ * on first use. NULL when the table is full or the name is already
+ * taken by a metric of another kind
+ *
+ * @param  int          kind
+ * @param  const char * format printf style name
+ * @return struct metric *
+ */
+struct metric *metric_register( int kind, const char *format, ... )
+{
+    char    name[ METRIC_NAME_LENGTH ];
+    va_list arguments;
+
+    if ( metric_registry == NULL ) return NULL;
+
+    va_start( arguments, format );
+    vsnprintf( name, sizeof( name ), format, arguments );
+    va_end( arguments );
+
+    uint32_t start = hash_name( name );
+
+    for ( uint probe = 0; probe < METRICS_CAPACITY; probe++ )
+    {
+        struct metric *metric = &metric_registry->slot[ ( start + probe ) & ( METRICS_CAPACITY - 1 ) ];
+        uint32_t state = SLOT_EMPTY;
+
+        // - Claim an empty slot, the winner names it
+        if ( __atomic_compare_exchange_n( &metric->state, &state, SLOT_CLAIMED, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE ) )
+        {
+            metric->kind = kind;
+            strcpy( metric->name, name );
+            __atomic_fetch_add( &metric_registry->used, 1, __ATOMIC_RELAXED );
+            __atomic_store_n( &metric->state, SLOT_READY, __ATOMIC_RELEASE );
+
+            return metric;
+        }
+
+        // - Another process is naming the slot, wait for it
+        while ( state == SLOT_CLAIMED )
+        {
+            cpu_relax();
+            state = __atomic_load_n( &metric->state, __ATOMIC_ACQUIRE );
+        }
+
+        if ( strcmp( metric->name, name ) == 0 ) return metric->kind == (uint32_t)kind ? metric : NULL;
+    }
+
+    return NULL;
+}
+
+static int compare_names( const void *a, const void *b )
+{
+    return strcmp( ( *(struct metric * const *)a )->name, ( *(struct metric * const *)b )->name );
+}
+
+/**
+ * Returns the upper bound of the bucket holding the 'quantile'
+ * of the histogram samples
+ *
+ * @param  struct metric * metric
+ * @param  double          quantile
+ * @return uint64_t
+ */
+uint64_t metric_quantile( struct metric *metric, double quantile )
+{
+    if ( metric == NULL ) return 0;
+
+    uint64_t rank = (uint64_t)( quantile * metric->value );
+    uint64_t seen = 0;
+
+    for ( uint i = 0; i < METRIC_BUCKETS; i++ )
+    {
+        seen += metric->bucket[i];
+        if ( seen > rank ) return i ? ( 1ull << i ) - 1 : 0;
+    }
+
+    return ( 1ull << ( METRIC_BUCKETS - 1 ) ) - 1;
+}
+
+/**
+ * Store up to 'max' registered metrics in 'list', sorted by name
+ *
+ * @param  struct metric ** list
+ * @param  uint             max
+ * @return uint             metrics stored
+ */
+uint metrics_collect( struct metric **list, uint max )
+{
+    uint count = 0;
+
+    if ( metric_registry == NULL ) return 0;
+
+    for ( uint i = 0; i < METRICS_CAPACITY && count < max; i++ )
+    {
+        struct metric *metric = &metric_registry->slot[i];
+
+        if ( __atomic_load_n( &metric->state, __ATOMIC_ACQUIRE ) == SLOT_READY ) list[ count++ ] = metric;
+    }
+
+    qsort( list, count, sizeof( list[0] ), compare_names );
+
+    return count;
+}
+
+/**
+ * Display the metrics updated so far, sorted by name
+ */
+void metrics_print_report()
+{
+    struct metric *sorted[ METRICS_CAPACITY ];
+    uint registered = metrics_collect( sorted, METRICS_CAPACITY );
+    uint count = 0;
+
+    // - Keep the metrics with a value
+    for ( uint i = 0; i < registered; i++ )
+    {
+        if ( sorted[i]->value != 0 ) sorted[ count++ ] = sorted[i];
+    }
+
+    if ( count == 0 ) return;
+
+    printf( "\tMetrics (%u registered):\n", registered );
+
+    for ( uint i = 0; i < count; i++ )
+    {
+        struct metric *metric = sorted[i];
+
+        if ( metric->kind == METRIC_HISTOGRAM )
+        {
+            printf( "\t\t%-40s n %lli, mean %lli, p50 <= %llu, p99 <= %llu\n", metric->name,
+                    (long long)metric->value, (long long)( metric->sum / metric->value ),
+                    (unsigned long long)metric_quantile( metric, 0.5 ),
+                    (unsigned long long)metric_quantile( metric, 0.99 ) );
+        }
+        else printf( "\t\t%-40s %lli\n", metric->name, (long long)metric->value );
+    }
+}
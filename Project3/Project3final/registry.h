@@ -0,0 +1,95 @@
+#ifndef _REGISTRY_H_
+#define _REGISTRY_H_
+
+/* Description:
+ * Named metric registry in shared memory.
+ * Processes register counters, gauges and histograms by name into a fixed
+ * capacity open addressing table (linear probing on a FNV-1a hash). A slot
+ * is claimed with a compare-and-swap, so concurrent registrations of the
+ * same name from several processes resolve to the same slot. Registration
+ * returns the slot pointer, the hot path updates it with one atomic add
+ * and never looks the name up again.
+ * Metrics registered by the parent before the fork are shared by the
+ * children through the inherited mapping.
+ */
+#include <stdint.h>
+
+#define METRICS_FILE        "/metrics"
+#define METRICS_CAPACITY    256       /* power of two */
+#define METRIC_NAME_LENGTH  48
+#define METRIC_BUCKETS      32        /* log2 buckets of the histograms */
+
+enum metric_kind
+{
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+};
+
+struct metric
+{
+    uint32_t state;                   /* empty, claimed or ready */
+    uint32_t kind;
+    char     name[ METRIC_NAME_LENGTH ];
+    int64_t  value;                   /* total, level or sample count */
+    int64_t  sum;                     /* of the histogram samples */
+    uint64_t bucket[ METRIC_BUCKETS ];
+} __attribute__(( aligned( 64 ) ));
+
+struct metric_registry
+{
+    uint32_t      used;
+    struct metric slot[ METRICS_CAPACITY ];
+};
+
+extern struct metric_registry *metric_registry;
+
+int            metrics_init();
+void           metrics_remove();
+struct metric *metric_register( int kind, const char *format, ... ) __attribute__(( format( printf, 2, 3 ) ));
+uint64_t       metric_quantile( struct metric *metric, double quantile );
+uint           metrics_collect( struct metric **list, uint max );
+void           metrics_print_report();
+
+/**
+ * Add 'amount' to a counter or gauge, a NULL metric is ignored
+ *
+ * @param struct metric * metric
+ * @param int64_t         amount
+ */
+static inline void metric_add( struct metric *metric, int64_t amount )
+{
+    if ( metric ) __atomic_fetch_add( &metric->value, amount, __ATOMIC_RELAXED );
+}
+
+/**
+ * Set the level of a gauge
+ *
+ * @param struct metric * metric
+ * @param int64_t         value
+ */
+static inline void metric_set( struct metric *metric, int64_t value )
+{
+    if ( metric ) __atomic_store_n( &metric->value, value, __ATOMIC_RELAXED );
+}
+
+/**
+ * Record 'sample' in a histogram, bucket i holds the samples
+ * of bit length i
+ *
+ * @param struct metric * metric
+ * @param uint64_t        sample
+ */
+static inline void metric_observe( struct metric *metric, uint64_t sample )
+{
+    if ( !metric ) return;
+
+    uint bucket = sample ? 64 - __builtin_clzll( sample ) : 0;
+    if ( bucket >= METRIC_BUCKETS ) bucket = METRIC_BUCKETS - 1;
+
+    __atomic_fetch_add( &metric->bucket[ bucket ], 1, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &metric->sum, sample, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &metric->value, 1, __ATOMIC_RELAXED );
+}
+
+#endif /* _REGISTRY_H_ */
@@ -0,0 +1,272 @@
+#include "header.h"
+#include "seg_lock.h"
+#include <sched.h>
+
+/**
+ * Initialize 'lock' of 'kind' and clear its statistics,
+ * before any process uses the segment
+ *
+ * @param  struct seg_lock * lock
+ * @param  int               kind
+ * @return int
+ */
+int seg_lock_init( struct seg_lock *lock, int kind )
+{
+    pthread_mutexattr_t attributes;
+
+    memset( lock, 0, sizeof( struct seg_lock ) );
+    lock->kind = kind;
+
+    if ( kind != SEG_LOCK_MUTEX ) return 1;
+
+    pthread_mutexattr_init( &attributes );
+    pthread_mutexattr_setpshared( &attributes, PTHREAD_PROCESS_SHARED );
+    pthread_mutexattr_setrobust( &attributes, PTHREAD_MUTEX_ROBUST );
+
+    int result = pthread_mutex_init( &lock->mutex, &attributes );
+    pthread_mutexattr_destroy( &attributes );
+
+    return result == 0;
+}
+
+/**
+ * Returns whether 'lock', left in a segment by a previous run, can be used
+ * as a lock of 'kind': a ticket lock its holder died in never opens again,
+ * the robust mutex recovers by itself
+ *
+ * @param  const struct seg_lock * lock
+ * @param  int                     kind
+ * @return int
+ */
+int seg_lock_valid( const struct seg_lock *lock, int kind )
+{
+    if ( lock->kind != (uint32_t)kind ) return 0;
+
+    return lock->ticket_next == lock->ticket_serving;
+}
+
+/**
+ * Account one attempt that waited 'wait_ns' behind 'blocker'
+ *
+ * @param struct seg_lock_stats * stats
+ * @param uint64_t                wait_ns
+ * @param pid_t                   blocker
+ */
+static void record_wait( struct seg_lock_stats *stats, uint64_t wait_ns, pid_t blocker )
+{
+    uint bucket = wait_ns ? 64 - __builtin_clzll( wait_ns ) : 0;
+    if ( bucket >= SEG_LOCK_BUCKETS ) bucket = SEG_LOCK_BUCKETS - 1;
+
+    __atomic_fetch_add( &stats->wait_histogram[ bucket ], 1, __ATOMIC_RELAXED );
+
+    if ( wait_ns == 0 ) return;
+
+    __atomic_fetch_add( &stats->contended, 1, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &stats->wait_sum_ns, wait_ns, __ATOMIC_RELAXED );
+
+    uint64_t seen = __atomic_load_n( &stats->wait_max_ns, __ATOMIC_RELAXED );
+
+    while ( wait_ns > seen )
+    {
+        if ( __atomic_compare_exchange_n( &stats->wait_max_ns, &seen, wait_ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+        {
+            __atomic_store_n( &stats->max_wait_holder, blocker, __ATOMIC_RELAXED );
+            break;
+        }
+    }
+}
+
+/**
+ * Take the ticket lock
+ *
+ * @param struct seg_lock * lock
+ */
+static void ticket_acquire( struct seg_lock *lock )
+{
+    uint32_t ticket = __atomic_fetch_add( &lock->ticket_next, 1, __ATOMIC_RELAXED );
+
+    if ( __atomic_load_n( &lock->ticket_serving, __ATOMIC_ACQUIRE ) == ticket )
+    {
+        record_wait( &lock->stats, 0, 0 );
+        return;
+    }
+
+    pid_t    blocker = __atomic_load_n( &lock->stats.holder, __ATOMIC_RELAXED );
+    uint64_t started = get_timestamp_ns();
+    uint     spins = 0;
+
+    while ( __atomic_load_n( &lock->ticket_serving, __ATOMIC_ACQUIRE ) != ticket )
+    {
+        if ( ++spins % 100 == 0 ) sched_yield();
+        else cpu_relax();
+    }
+
+    record_wait( &lock->stats, get_timestamp_ns() - started + 1, blocker );
+}
+
+/**
+ * Take the robust mutex, recovering it from a dead holder
+ *
+ * @param struct seg_lock * lock
+ */
+static void mutex_acquire( struct seg_lock *lock )
+{
+    pid_t    blocker = 0;
+    uint64_t started = 0;
+
+    int result = pthread_mutex_trylock( &lock->mutex );
+
+    if ( result == EBUSY )
+    {
+        blocker = __atomic_load_n( &lock->stats.holder, __ATOMIC_RELAXED );
+        started = get_timestamp_ns();
+        result  = pthread_mutex_lock( &lock->mutex );
+    }
+
+    if ( result == EOWNERDEAD )
+    {
+        pthread_mutex_consistent( &lock->mutex );
+        __atomic_fetch_add( &lock->stats.owner_died, 1, __ATOMIC_RELAXED );
+    }
+
+    record_wait( &lock->stats, started ? get_timestamp_ns() - started + 1 : 0, blocker );
+}
+
+/**
+ * Enter the critical section of 'lock'
+ *
+ * @param struct seg_lock * lock
+ */
+void seg_lock_acquire( struct seg_lock *lock )
+{
+    __atomic_fetch_add( &lock->stats.attempts, 1, __ATOMIC_RELAXED );
+
+    if ( lock->kind == SEG_LOCK_MUTEX ) mutex_acquire( lock );
+    else ticket_acquire( lock );
+
+    __atomic_store_n( &lock->stats.holder, getpid(), __ATOMIC_RELAXED );
+}
+
+/**
+ * Leave the critical section of 'lock'
+ *
+ * @param struct seg_lock * lock
+ */
+void seg_lock_release( struct seg_lock *lock )
+{
+    if ( lock->kind == SEG_LOCK_MUTEX )
+    {
+        pthread_mutex_unlock( &lock->mutex );
+        return;
+    }
+
+    // - Only the holder advances the serving ticket
+    __atomic_store_n( &lock->ticket_serving, lock->ticket_serving + 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Add 'delta' to the shared '*value' under 'lock', the atomic kind
+ * updates it with a compare-and-swap loop instead
+ *
+ * @param struct seg_lock * lock
+ * @param int *             value
+ * @param int               delta
+ */
+void seg_lock_add( struct seg_lock *lock, int *value, int delta )
+{
+    if ( lock->kind != SEG_LOCK_ATOMIC )
+    {
+        seg_lock_acquire( lock );
+        *value += delta;
+        seg_lock_release( lock );
+        return;
+    }
+
+    __atomic_fetch_add( &lock->stats.attempts, 1, __ATOMIC_RELAXED );
+
+    int seen = __atomic_load_n( value, __ATOMIC_RELAXED );
+
+    if ( __atomic_compare_exchange_n( value, &seen, seen + delta, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+    {
+        record_wait( &lock->stats, 0, 0 );
+    }
+    else
+    {
+        pid_t    blocker = __atomic_load_n( &lock->stats.holder, __ATOMIC_RELAXED );
+        uint64_t started = get_timestamp_ns();
+        uint64_t retries = 1;
+
+        while ( !__atomic_compare_exchange_n( value, &seen, seen + delta, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) retries++;
+
+        __atomic_fetch_add( &lock->stats.retries, retries, __ATOMIC_RELAXED );
+        record_wait( &lock->stats, get_timestamp_ns() - started + 1, blocker );
+    }
+
+    __atomic_store_n( &lock->stats.holder, getpid(), __ATOMIC_RELAXED );
+}
+
+/**
+ * Returns the name of the lock 'kind'
+ *
+ * @param  int kind
+ * @return const char *
+ */
+const char *seg_lock_kind_name( int kind )
+{
+    if ( kind == SEG_LOCK_MUTEX )  return "mutex";
+    if ( kind == SEG_LOCK_TICKET ) return "ticket";
+
+    return "atomic";
+}
+
+/**
+ * Returns the upper bound of the wait time bucket holding the 'fraction'
+ * quantile of the contended attempts, 0 without contention
+ *
+ * @param  const struct seg_lock_stats * stats
+ * @param  double                        fraction
+ * @return uint64_t ns
+ */
+uint64_t seg_lock_quantile( const struct seg_lock_stats *stats, double fraction )
+{
+    uint64_t total = 0, seen = 0;
+
+    for ( uint i = 1; i < SEG_LOCK_BUCKETS; i++ ) total += stats->wait_histogram[i];
+    if ( total == 0 ) return 0;
+
+    for ( uint i = 1; i < SEG_LOCK_BUCKETS; i++ )
+    {
+        seen += stats->wait_histogram[i];
+        if ( seen >= fraction * total ) return 1ull << i;
+    }
+
+    return 1ull << ( SEG_LOCK_BUCKETS - 1 );
+}
+
+/**
+ * Display the contention statistics 'stats' of a lock of 'kind' as 'name'
+ *
+ * @param const char *                  name
+ * @param int                           kind
+ * @param const struct seg_lock_stats * stats
+ */
+void seg_lock_print_report( const char *name, int kind, const struct seg_lock_stats *stats )
+{
+    if ( stats->attempts == 0 ) return;
+
+    printf( "\t%s (%s): %llu attempts, %.2f%% contended, contended wait avg %lluns p50 <%lluns p99 <%lluns max %lluns\n",
+            name, seg_lock_kind_name( kind ), (unsigned long long)stats->attempts,
+            100.0 * stats->contended / stats->attempts,
+            (unsigned long long)( stats->contended ? stats->wait_sum_ns / stats->contended : 0 ),
+            (unsigned long long)seg_lock_quantile( stats, 0.50 ),
+            (unsigned long long)seg_lock_quantile( stats, 0.99 ),
+            (unsigned long long)stats->wait_max_ns );
+
+    printf( "\t\t%s pid %i, longest wait behind pid %i", kind == SEG_LOCK_ATOMIC ? "last updater" : "last holder",
+            stats->holder, stats->max_wait_holder );
+
+    if ( kind == SEG_LOCK_ATOMIC ) printf( ", %llu lost compare-and-swaps", (unsigned long long)stats->retries );
+    if ( kind == SEG_LOCK_MUTEX )  printf( ", %llu owner deaths recovered", (unsigned long long)stats->owner_died );
+
+    printf( "\n" );
+}
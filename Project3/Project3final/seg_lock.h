@@ -0,0 +1,63 @@
+#ifndef _SEG_LOCK_H_
+#define _SEG_LOCK_H_
+
+/* Description:
+ * Instrumented lock living inside a shared segment, three kinds:
+ *  - mutex:  robust process-shared pthread mutex, a holder dying inside the
+ *            section hands the next acquirer EOWNERDEAD, the lock is made
+ *            consistent again and the recovery counted
+ *  - ticket: FIFO ticket spinlock, yields the cpu every 100 spins like
+ *            spinlock.h, not robust
+ *  - atomic: no section, seg_lock_add() updates the value with a
+ *            compare-and-swap loop. seg_lock_acquire() on this kind takes
+ *            the ticket lock
+ * Every acquisition (every update on the lock-free path) is counted. An
+ * attempt that finds the lock taken (or loses the compare-and-swap) is
+ * contended, its wait time goes into a log2 histogram, bucket 0 holds the
+ * uncontended attempts. The pid of the last holder (the last updater on the
+ * lock-free path) stays in the lock, a waiter blames the longest wait on the
+ * holder it found when it started waiting. The statistics are updated with
+ * relaxed atomics, the fast path reads no clock.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SEG_LOCK_MUTEX    0
+#define SEG_LOCK_TICKET   1
+#define SEG_LOCK_ATOMIC   2
+
+#define SEG_LOCK_BUCKETS  32
+
+struct seg_lock_stats
+{
+    uint64_t attempts;
+    uint64_t contended;
+    uint64_t retries;                         /* lost compare-and-swaps */
+    uint64_t wait_sum_ns;
+    uint64_t wait_max_ns;
+    uint64_t wait_histogram[ SEG_LOCK_BUCKETS ];
+    uint64_t owner_died;                      /* robust mutex recoveries */
+    int32_t  holder;                          /* current or last holder */
+    int32_t  max_wait_holder;                 /* held the lock during the longest wait */
+};
+
+struct seg_lock
+{
+    uint32_t              kind;
+    uint32_t              ticket_next;
+    uint32_t              ticket_serving;
+    pthread_mutex_t       mutex;
+    struct seg_lock_stats stats;
+} __attribute__(( aligned( 64 ) ));
+
+int         seg_lock_init( struct seg_lock *lock, int kind );
+int         seg_lock_valid( const struct seg_lock *lock, int kind );
+void        seg_lock_acquire( struct seg_lock *lock );
+void        seg_lock_release( struct seg_lock *lock );
+void        seg_lock_add( struct seg_lock *lock, int *value, int delta );
+const char *seg_lock_kind_name( int kind );
+uint64_t    seg_lock_quantile( const struct seg_lock_stats *stats, double fraction );
+void        seg_lock_print_report( const char *name, int kind, const struct seg_lock_stats *stats );
+
+#endif /* _SEG_LOCK_H_ */
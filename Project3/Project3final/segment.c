@@ -0,0 +1,365 @@
+#include "header.h"
+#include "options.h"
+#include "segment.h"
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/**
+ * Segments mapped by this process, inherited by the children through
+ * fork() so they can prefault and lock them again: page tables of shared
+ * mappings and memory locks are not inherited
+ */
+static struct segment_mapping
+{
+    void  *address;
+    size_t size;
+    int    huge;
+} mapping[ SEGMENT_MAX ];
+
+static struct segment_stats segment_stats;
+
+// - Set by the simulation, segment_create() maps private anonymous memory
+// - and segment_remove() leaves the named segments of a live run alone
+int segment_private = 0;
+
+/**
+ * Returns the path of 'name' on the hugetlbfs mount
+ *
+ * @param  const char * name
+ * @param  char *       path
+ * @return char *       path
+ */
+static char *huge_path( const char *name, char *path )
+{
+    snprintf( path, 256, "%s%s", HUGETLBFS_MOUNT, name );
+
+    return path;
+}
+
+/**
+ * Returns whether transparent huge pages can back shared memory
+ *
+ * @return int
+ */
+static int shmem_thp_available()
+{
+    char  setting[ 128 ];
+    FILE *file = fopen( "/sys/kernel/mm/transparent_hugepage/shmem_enabled", "r" );
+
+    if ( file == NULL ) return 0;
+
+    int found = fgets( setting, sizeof( setting ), file ) != NULL;
+    fclose( file );
+
+    return found && strstr( setting, "[never]" ) == NULL && strstr( setting, "[deny]" ) == NULL;
+}
+
+/**
+ * Try to create the segment as a file on the hugetlbfs mount,
+ * 'size' is rounded up to whole huge pages
+ *
+ * @param  const char * name
+ * @param  size_t *     size
+ * @return void *       mapped address, NULL when no huge pages are available
+ */
+static void *huge_create( const char *name, size_t *size )
+{
+    char   path[ 256 ];
+    size_t rounded = ( *size + HUGE_PAGE_SIZE - 1 ) & ~( HUGE_PAGE_SIZE - 1 );
+
+    int fd = open( huge_path( name, path ), O_CREAT | O_RDWR, 0666 );
+    if ( fd == -1 ) return NULL;
+
+    void *address = MAP_FAILED;
+
+    if ( ftruncate( fd, rounded ) == 0 )
+    {
+        address = mmap( 0, rounded, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0 );
+    }
+    close( fd );
+
+    if ( address == MAP_FAILED )
+    {
+        unlink( path );
+        return NULL;
+    }
+
+    *size = rounded;
+
+    return address;
+}
+
+/**
+ * Prefault, lock and advise the mapping as the options ask,
+ * failures leave the mapping usable
+ *
+ * @param struct segment_mapping * segment
+ */
+static void prepare( struct segment_mapping *segment )
+{
+    // - Advise before populating so the faults can allocate huge pages
+    if ( options.hugepages == HUGEPAGES_TRANSPARENT && !segment->huge )
+    {
+        madvise( segment->address, segment->size, MADV_HUGEPAGE );
+    }
+
+    if ( options.prefault && !segment->huge )
+    {
+        // - Fall back to writing one word per page before Linux 5.14, a read
+        // - of a shared mapping only maps the page read-only. Adding 0
+        // - atomically keeps the content other processes may be writing
+        if ( madvise( segment->address, segment->size, MADV_POPULATE_WRITE ) == -1 )
+        {
+            long page = sysconf( _SC_PAGESIZE );
+
+            for ( size_t offset = 0; offset < segment->size; offset += page )
+            {
+                __atomic_fetch_add( (uint32_t *)( (char *)segment->address + offset ), 0, __ATOMIC_RELAXED );
+            }
+        }
+    }
+
+    if ( options.mlock )
+    {
+        if ( mlock( segment->address, segment->size ) == 0 ) segment_stats.locked++;
+        else segment_stats.lock_failures++;
+    }
+}
+
+/**
+ * Remember and prepare a segment mapped by this process
+ *
+ * @param void * address
+ * @param size_t size
+ * @param int    huge
+ */
+static void track( void *address, size_t size, int huge )
+{
+    for ( uint i = 0; i < SEGMENT_MAX; i++ )
+    {
+        if ( mapping[i].address != NULL ) continue;
+
+        mapping[i].address = address;
+        mapping[i].size    = size;
+        mapping[i].huge    = huge;
+
+        segment_stats.segments++;
+        segment_stats.bytes += size;
+        segment_stats.huge  += huge;
+
+        prepare( &mapping[i] );
+        return;
+    }
+}
+
+/**
+ * Returns the mmap() flags of the shared segments,
+ * MAP_POPULATE when prefaulting
+ *
+ * @return int
+ */
+int segment_map_flags()
+{
+    return MAP_SHARED | ( options.prefault ? MAP_POPULATE : 0 );
+}
+
+/**
+ * Create (or truncate) the named shared memory segment, map it
+ * and initialize its content to zero
+ *
+ * @param  const char * name
+ * @param  size_t       size
+ * @return void *       mapped address, NULL on failure
+ */
+void *segment_create( const char *name, size_t size )
+{
+    if ( segment_private )
+    {
+        void *address = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( address == MAP_FAILED )
+        {
+            perror( "mmap()" );
+            return NULL;
+        }
+        return address;
+    }
+
+    if ( options.hugepages == HUGEPAGES_EXPLICIT )
+    {
+        void *address = huge_create( name, &size );
+
+        if ( address != NULL )
+        {
+            memset( address, 0, size );
+            track( address, size, 1 );
+            return address;
+        }
+        segment_stats.huge_failures++;
+    }
+
+    int shm_fd = shm_open( name, O_CREAT | O_RDWR, 0666 );
+    if ( shm_fd == -1 )
+    {
+        perror( "shm_open()" );
+        return NULL;
+    }
+
+    if ( ftruncate( shm_fd, size ) == -1 )
+    {
+        perror( "ftruncate()" );
+        close( shm_fd );
+        return NULL;
+    }
+
+    void *address = mmap( 0, size, PROT_READ | PROT_WRITE, segment_map_flags(), shm_fd, 0 );
+    close( shm_fd );
+
+    if ( address == MAP_FAILED )
+    {
+        perror( "mmap()" );
+        return NULL;
+    }
+
+    memset( address, 0, size );
+    track( address, size, 0 );
+
+    return address;
+}
+
+/**
+ * Map 'size' bytes of the open file 'fd' shared, prefaulted, locked and
+ * advised like the named segments, the content is kept
+ *
+ * @param  int    fd
+ * @param  size_t size
+ * @return void * mapped address, NULL on failure
+ */
+void *segment_map_file( int fd, size_t size )
+{
+    void *address = mmap( 0, size, PROT_READ | PROT_WRITE, segment_map_flags(), fd, 0 );
+
+    if ( address == MAP_FAILED )
+    {
+        perror( "mmap()" );
+        return NULL;
+    }
+
+    track( address, size, 0 );
+
+    return address;
+}
+
+/**
+ * Map an already existing named shared memory segment
+ *
+ * @param  const char * name
+ * @param  size_t       size
+ * @return void *       mapped address, NULL on failure
+ */
+void *segment_attach( const char *name, size_t size )
+{
+    char path[ 256 ];
+    int  huge = 1;
+
+    int shm_fd = open( huge_path( name, path ), O_RDWR );
+    if ( shm_fd == -1 )
+    {
+        huge = 0;
+        shm_fd = shm_open( name, O_RDWR, 0666 );
+    }
+    if ( shm_fd == -1 )
+    {
+        perror( "shm_open()" );
+        return NULL;
+    }
+
+    if ( huge ) size = ( size + HUGE_PAGE_SIZE - 1 ) & ~( HUGE_PAGE_SIZE - 1 );
+
+    void *address = mmap( 0, size, PROT_READ | PROT_WRITE, segment_map_flags(), shm_fd, 0 );
+    close( shm_fd );
+
+    if ( address == MAP_FAILED ) return NULL;
+
+    track( address, size, huge );
+
+    return address;
+}
+
+/**
+ * Unmap a segment from this process
+ *
+ * @param void * address
+ * @param size_t size
+ */
+void segment_detach( void *address, size_t size )
+{
+    if ( address == NULL ) return;
+
+    for ( uint i = 0; i < SEGMENT_MAX; i++ )
+    {
+        if ( mapping[i].address != address ) continue;
+
+        size = mapping[i].size;
+        mapping[i].address = NULL;
+        break;
+    }
+
+    munmap( address, size );
+}
+
+/**
+ * Remove the named segment from the os
+ *
+ * @param const char * name
+ */
+void segment_remove( const char *name )
+{
+    char path[ 256 ];
+
+    if ( segment_private ) return;
+
+    shm_unlink( name );
+    unlink( huge_path( name, path ) );
+}
+
+/**
+ * Prefault and lock again the segments inherited from the parent,
+ * called by every child process once after the fork
+ */
+void segment_prefault()
+{
+    if ( !options.prefault && !options.mlock ) return;
+
+    segment_stats.locked = segment_stats.lock_failures = 0;
+
+    for ( uint i = 0; i < SEGMENT_MAX; i++ )
+    {
+        if ( mapping[i].address != NULL ) prepare( &mapping[i] );
+    }
+}
+
+/**
+ * Display how the segments of this process are backed
+ */
+void segment_print_report()
+{
+    if ( !options.prefault && !options.mlock && !options.hugepages ) return;
+
+    printf( "\tSegments: %u, %llu KiB, prefault %s, locked %u/%u",
+            segment_stats.segments, (unsigned long long)segment_stats.bytes / 1024,
+            options.prefault ? "on" : "off", segment_stats.locked,
+            segment_stats.locked + segment_stats.lock_failures );
+
+    if ( options.hugepages == HUGEPAGES_EXPLICIT )
+    {
+        printf( ", hugetlbfs %u (%u fell back)", segment_stats.huge, segment_stats.huge_failures );
+    }
+    else if ( options.hugepages == HUGEPAGES_TRANSPARENT )
+    {
+        printf( ", transparent huge pages %s", shmem_thp_available() ? "advised" : "unavailable for shmem" );
+    }
+
+    printf( "\n" );
+}
@@ -0,0 +1,44 @@
+#ifndef _SEGMENT_H_
+#define _SEGMENT_H_
+
+/* Description:
+ * Helpers for the named POSIX shared memory segments used by the
+ * application. A segment is created and mapped once by the parent process,
+ * the child processes inherit the mapping through fork().
+ * On request the segments are prefaulted (--prefault), locked in memory
+ * (--mlock) and backed by transparent or hugetlbfs huge pages
+ * (--hugepages), falling back to regular pages when none are available.
+ * The children call segment_prefault() after the fork since neither the
+ * page tables of shared mappings nor memory locks survive it.
+ * The simulation sets segment_private: its segments are anonymous memory
+ * of the process and never touch the named segments.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEGMENT_MAX      16
+#define HUGETLBFS_MOUNT  "/dev/hugepages"
+#define HUGE_PAGE_SIZE   ( (size_t)2 << 20 )
+
+struct segment_stats
+{
+    uint     segments;
+    uint64_t bytes;
+    uint     huge;            /* backed by hugetlbfs */
+    uint     huge_failures;   /* fell back to regular pages */
+    uint     locked;
+    uint     lock_failures;
+};
+
+extern int segment_private;
+
+void *segment_create( const char *name, size_t size );
+void *segment_attach( const char *name, size_t size );
+void *segment_map_file( int fd, size_t size );
+void  segment_detach( void *address, size_t size );
+void  segment_remove( const char *name );
+int   segment_map_flags();
+void  segment_prefault();
+void  segment_print_report();
+
+#endif /* _SEGMENT_H_ */
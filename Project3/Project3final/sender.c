@@ -0,0 +1,198 @@
+#include "header.h"
+#include "segment.h"
+#include "sender.h"
+
+struct sender_table *sender_table = NULL;
+
+// - Slot of the generator running in this process or thread
+static __thread int self = SENDER_NONE;
+
+/**
+ * Create the sender table
+ *
+ * @return int
+ */
+int sender_init()
+{
+    sender_table = segment_create( SENDER_FILE, sizeof( struct sender_table ) );
+
+    return sender_table != NULL;
+}
+
+/**
+ * Remove the sender file from the os
+ */
+void sender_remove()
+{
+    segment_remove( SENDER_FILE );
+}
+
+/**
+ * Claim the slot of generator 'id' for the calling process
+ *
+ * @param int id
+ */
+void sender_register( int id )
+{
+    if ( sender_table == NULL || id < 0 || id >= MAX_TX_PROCESSES ) return;
+
+    self = id;
+    __atomic_store_n( &sender_table->slot[ id ].pid, getpid(), __ATOMIC_RELEASE );
+    __atomic_store_n( &sender_table->slot[ id ].generator, 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Account one emission of 'type' to the generator of this process
+ *
+ * @param int type
+ */
+void sender_emitted( int type )
+{
+    if ( self == SENDER_NONE ) return;
+
+    struct sender_slot *slot = &sender_table->slot[ self ];
+
+    __atomic_fetch_add( &slot->emitted, 1, __ATOMIC_RELAXED );
+    __atomic_store_n( &slot->last_emit_ns[ type ], get_timestamp_ns(), __ATOMIC_RELAXED );
+}
+
+/**
+ * Returns the slot of the generator with 'pid', SENDER_NONE if unknown
+ *
+ * @param  pid_t pid
+ * @return int
+ */
+int sender_lookup( pid_t pid )
+{
+    if ( sender_table == NULL || pid <= 0 ) return SENDER_NONE;
+
+    for ( int i = 0; i < MAX_TX_PROCESSES; i++ )
+    {
+        if ( __atomic_load_n( &sender_table->slot[i].pid, __ATOMIC_ACQUIRE ) == pid ) return i;
+    }
+
+    return SENDER_NONE;
+}
+
+/**
+ * Raise '*max' to 'value'
+ *
+ * @param uint64_t * max
+ * @param uint64_t   value
+ */
+static void update_max( uint64_t *max, uint64_t value )
+{
+    uint64_t seen = __atomic_load_n( max, __ATOMIC_RELAXED );
+
+    while ( value > seen && !__atomic_compare_exchange_n( max, &seen, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+}
+
+/**
+ * Account one received event of 'type' to 'slot'. 'sent_ns' is the
+ * send time the event carries, 0 measures from the newest emission
+ * of the type by that sender
+ *
+ * @param int      slot
+ * @param int      type
+ * @param uint64_t sent_ns
+ */
+void sender_received( int slot, int type, uint64_t sent_ns )
+{
+    if ( sender_table == NULL ) return;
+
+    if ( slot < 0 || slot >= MAX_TX_PROCESSES )
+    {
+        __atomic_fetch_add( &sender_table->unattributed, 1, __ATOMIC_RELAXED );
+        return;
+    }
+
+    struct sender_slot *sender = &sender_table->slot[ slot ];
+    uint64_t now = get_timestamp_ns();
+
+    __atomic_fetch_add( &sender->received, 1, __ATOMIC_RELAXED );
+
+    // - Inter-arrival over all the receivers of the sender
+    uint64_t previous = __atomic_exchange_n( &sender->last_receive_ns, now, __ATOMIC_RELAXED );
+    if ( previous != 0 && previous < now )
+    {
+        __atomic_fetch_add( &sender->interval_sum_ns, now - previous, __ATOMIC_RELAXED );
+        __atomic_fetch_add( &sender->interval_count, 1, __ATOMIC_RELAXED );
+        update_max( &sender->interval_max_ns, now - previous );
+    }
+
+    if ( sent_ns == 0 ) sent_ns = __atomic_load_n( &sender->last_emit_ns[ type ], __ATOMIC_RELAXED );
+    if ( sent_ns != 0 && sent_ns <= now )
+    {
+        __atomic_fetch_add( &sender->latency_sum_ns, now - sent_ns, __ATOMIC_RELAXED );
+        __atomic_fetch_add( &sender->latency_count, 1, __ATOMIC_RELAXED );
+        update_max( &sender->latency_max_ns, now - sent_ns );
+    }
+}
+
+/**
+ * Display the emission and reception rate, the latency and the
+ * inter-arrival time of every generator over the last 'seconds'.
+ * A generator emitting under half or over twice the mean rate is flagged
+ *
+ * @param double seconds
+ */
+void sender_print_report( double seconds )
+{
+    static uint64_t previous_emitted[ MAX_TX_PROCESSES ], previous_received[ MAX_TX_PROCESSES ];
+    static uint64_t previous_latency_sum[ MAX_TX_PROCESSES ], previous_latency_count[ MAX_TX_PROCESSES ];
+    static uint64_t previous_interval_sum[ MAX_TX_PROCESSES ], previous_interval_count[ MAX_TX_PROCESSES ];
+    double emit_rate[ MAX_TX_PROCESSES ], mean_rate = 0;
+    uint   generators = 0;
+
+    if ( sender_table == NULL || seconds <= 0 ) return;
+
+    for ( uint i = 0; i < MAX_TX_PROCESSES; i++ )
+    {
+        struct sender_slot *slot = &sender_table->slot[i];
+        if ( !slot->generator ) continue;
+
+        emit_rate[i] = ( slot->emitted - previous_emitted[i] ) / seconds;
+        mean_rate += emit_rate[i];
+        generators++;
+    }
+
+    if ( generators == 0 ) return;
+    mean_rate /= generators;
+
+    printf( "\tPer generator over %.3fs (unattributed events %llu):\n", seconds, (unsigned long long)sender_table->unattributed );
+
+    for ( uint i = 0; i < MAX_TX_PROCESSES; i++ )
+    {
+        struct sender_slot *slot = &sender_table->slot[i];
+        if ( !slot->generator ) continue;
+
+        uint64_t emitted  = slot->emitted, received = slot->received;
+        uint64_t latency_sum = slot->latency_sum_ns, latency_count = slot->latency_count;
+        uint64_t interval_sum = slot->interval_sum_ns, interval_count = slot->interval_count;
+        uint64_t latencies = latency_count - previous_latency_count[i];
+        uint64_t intervals = interval_count - previous_interval_count[i];
+
+        // - The maxima restart every report
+        uint64_t latency_max  = __atomic_exchange_n( &slot->latency_max_ns, 0, __ATOMIC_RELAXED );
+        uint64_t interval_max = __atomic_exchange_n( &slot->interval_max_ns, 0, __ATOMIC_RELAXED );
+
+        const char *flag = "";
+        if ( mean_rate > 0 && emit_rate[i] > 2 * mean_rate ) flag = "  << runaway";
+        else if ( mean_rate > 0 && emit_rate[i] < mean_rate / 2 ) flag = "  << slow";
+
+        printf( "\t\tGenerator %2u pid %-7i emitted %8.1f/s received %8.1f/s, latency avg %7lluus max %7lluus, "
+                "inter-arrival avg %7lluus max %7lluus%s\n",
+                i, slot->pid, emit_rate[i], ( received - previous_received[i] ) / seconds,
+                (unsigned long long)( latencies ? ( latency_sum - previous_latency_sum[i] ) / latencies / 1000 : 0 ),
+                (unsigned long long)( latency_max / 1000 ),
+                (unsigned long long)( intervals ? ( interval_sum - previous_interval_sum[i] ) / intervals / 1000 : 0 ),
+                (unsigned long long)( interval_max / 1000 ), flag );
+
+        previous_emitted[i]        = emitted;
+        previous_received[i]       = received;
+        previous_latency_sum[i]    = latency_sum;
+        previous_latency_count[i]  = latency_count;
+        previous_interval_sum[i]   = interval_sum;
+        previous_interval_count[i] = interval_count;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef _SENDER_H_
+#define _SENDER_H_
+
+/* Description:
+ * Per-sender attribution of the received events.
+ * Every generator claims the slot of its id in a shared table and stamps
+ * its pid into it. Receivers attribute each event to a slot: the signal
+ * handlers by the si_pid of sigwaitinfo() (the generator id carried by a
+ * queued sequence value wins, threads of one process share their pid), the
+ * socket transport by the sender pid of the event, the deque by the
+ * generator id of the item. Events of pids not in the table are counted
+ * as unattributed, the spin path consumes counts, not events, and is not
+ * attributed.
+ * A slot keeps the emission and reception totals, the last emission time
+ * per signal type (the latency of a signal is measured from it) and the
+ * sum / max of the reception inter-arrival times and latencies, updated
+ * with relaxed atomics. The reporter turns the deltas into rates.
+ */
+#include <stdint.h>
+
+#define SENDER_FILE "/senders"
+#define SENDER_NONE -1
+
+struct sender_slot
+{
+    int32_t  pid;
+    uint32_t generator;               /* slot claimed */
+    uint64_t emitted;
+    uint64_t received;
+    uint64_t last_emit_ns[ 2 ];
+    uint64_t last_receive_ns;
+    uint64_t interval_sum_ns;
+    uint64_t interval_count;
+    uint64_t interval_max_ns;
+    uint64_t latency_sum_ns;
+    uint64_t latency_count;
+    uint64_t latency_max_ns;
+} __attribute__(( aligned( 64 ) ));
+
+struct sender_table
+{
+    uint64_t           unattributed;
+    struct sender_slot slot[ MAX_TX_PROCESSES ];
+};
+
+extern struct sender_table *sender_table;
+
+int  sender_init();
+void sender_remove();
+void sender_register( int id );
+void sender_emitted( int type );
+int  sender_lookup( pid_t pid );
+void sender_received( int slot, int type, uint64_t sent_ns );
+void sender_print_report( double seconds );
+
+#endif /* _SENDER_H_ */
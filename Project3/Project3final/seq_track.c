@@ -0,0 +1,180 @@
+#include "header.h"
+#include "options.h"
+#include "segment.h"
+#include "spinlock.h"
+#include "seq_track.h"
+
+struct seq_tracking *seq_tracking = NULL;
+
+/**
+ * Create the shared memory tracking table
+ *
+ * @return int
+ */
+int seq_track_init()
+{
+    seq_tracking = segment_create( SEQ_TRACK_FILE, sizeof( struct seq_tracking ) );
+
+    return seq_tracking != NULL;
+}
+
+/**
+ * Remove the tracking file from the os
+ */
+void seq_track_remove()
+{
+    segment_remove( SEQ_TRACK_FILE );
+}
+
+/**
+ * Returns the next sequence number of this producer for 'type',
+ * a producer is a process or a generator thread
+ *
+ * @param  int type
+ * @return uint32_t
+ */
+uint32_t seq_next( int type )
+{
+    static __thread uint32_t seq[ 2 ] = { 0, 0 };
+
+    return ++seq[ type ];
+}
+
+static int seen( struct seq_stream *stream, uint64_t seq )
+{
+    return ( stream->window[ ( seq % SEQ_WINDOW ) / 64 ] >> ( seq % 64 ) ) & 1;
+}
+
+static void mark( struct seq_stream *stream, uint64_t seq )
+{
+    stream->window[ ( seq % SEQ_WINDOW ) / 64 ] |= 1ull << ( seq % 64 );
+}
+
+static void clear( struct seq_stream *stream, uint64_t seq )
+{
+    stream->window[ ( seq % SEQ_WINDOW ) / 64 ] &= ~( 1ull << ( seq % 64 ) );
+}
+
+/**
+ * Returns the sequences below the high-water mark not seen yet,
+ * gaps still inside the window
+ *
+ * @param  struct seq_stream * stream
+ * @return uint64_t
+ */
+static uint64_t pending_gaps( struct seq_stream *stream )
+{
+    uint64_t gaps = 0;
+    uint64_t first = stream->high_water > SEQ_WINDOW ? stream->high_water - SEQ_WINDOW + 1 : 1;
+
+    for ( uint64_t seq = first; seq <= stream->high_water; seq++ ) gaps += !seen( stream, seq );
+
+    return gaps;
+}
+
+/**
+ * Account the reception of 'seq' from 'source' by 'consumer'
+ *
+ * @param int      consumer  handler slot, 0 for the deque pool
+ * @param uint     source    generator id
+ * @param int      type      0 SIGUSR1, 1 SIGUSR2
+ * @param uint64_t seq
+ */
+void seq_track( int consumer, uint source, int type, uint64_t seq )
+{
+    if ( seq_tracking == NULL || source >= SEQ_MAX_SOURCES || seq == 0 ) return;
+
+    struct seq_stream *stream = &seq_tracking->stream[ consumer ][ source ][ type ];
+
+    spin_lock( &stream->lock );
+
+    stream->active = 1;
+    stream->received++;
+
+    if ( seq > stream->high_water )
+    {
+        uint64_t advance = seq - stream->high_water;
+
+        // ----------------------------------------------
+        // - Slide the window, unseen sequences falling
+        // - out of it are lost
+        // ----------------------------------------------
+        if ( advance >= SEQ_WINDOW )
+        {
+            stream->lost += pending_gaps( stream ) + advance - SEQ_WINDOW;
+            memset( stream->window, 0, sizeof( stream->window ) );
+        }
+        else
+        {
+            for ( uint64_t next = stream->high_water + 1; next <= seq; next++ )
+            {
+                if ( next > SEQ_WINDOW && !seen( stream, next - SEQ_WINDOW ) ) stream->lost++;
+                clear( stream, next );
+            }
+        }
+
+        mark( stream, seq );
+        stream->high_water = seq;
+    }
+    else if ( seq + SEQ_WINDOW > stream->high_water )
+    {
+        if ( seen( stream, seq ) ) stream->duplicates++;
+        else
+        {
+            mark( stream, seq );
+            stream->reordered++;
+        }
+    }
+    else
+    {
+        // - Older than the window: already counted lost, it only came late
+        if ( stream->lost ) stream->lost--;
+        stream->reordered++;
+    }
+
+    spin_unlock( &stream->lock );
+}
+
+/**
+ * Display loss, duplication and reordering per generator and signal type
+ */
+void seq_track_print_report()
+{
+    static const char *transport[] = { "signal", "socket", "deque" };
+
+    if ( seq_tracking == NULL ) return;
+
+    printf( "\tSequence tracking over the %s transport\n", transport[ options.transport ] );
+
+    // - Over the socket and deque transports every virtual source is a stream
+    const char *producer = options.sources && options.transport != TRANSPORT_SIGNAL ? "Source" : "Generator";
+
+    for ( uint source = 0; source < SEQ_MAX_SOURCES; source++ )
+    {
+        for ( uint type = 0; type < 2; type++ )
+        {
+            uint64_t received = 0, lost = 0, duplicates = 0, reordered = 0, high_water = 0;
+            uint     consumers = 0;
+
+            for ( uint consumer = 0; consumer < MAX_RX_PROCESSES; consumer++ )
+            {
+                struct seq_stream *stream = &seq_tracking->stream[ consumer ][ source ][ type ];
+                if ( !stream->active ) continue;
+
+                consumers++;
+                received   += stream->received;
+                lost       += stream->lost + pending_gaps( stream );
+                duplicates += stream->duplicates;
+                reordered  += stream->reordered;
+                if ( stream->high_water > high_water ) high_water = stream->high_water;
+            }
+
+            if ( consumers == 0 ) continue;
+
+            printf( "\t\t%s %u %s: seq %llu, %u consumers, received %llu, lost %llu, duplicated %llu, reordered %llu\n",
+                    producer, source, type == 0 ? "SIGUSR1" : "SIGUSR2", (unsigned long long)high_water, consumers,
+                    (unsigned long long)received, (unsigned long long)lost,
+                    (unsigned long long)duplicates, (unsigned long long)reordered );
+        }
+    }
+}
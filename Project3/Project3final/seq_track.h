@@ -0,0 +1,51 @@
+#ifndef _SEQ_TRACK_H_
+#define _SEQ_TRACK_H_
+
+/* Description:
+ * Per-producer sequence numbers and gap detection.
+ * Every generator numbers its emissions per signal type from 1. A consumer
+ * (a handler for the broadcast transports, the whole pool for the deque)
+ * keeps per producer and type the high-water mark and a SEQ_WINDOW bit ring
+ * of the sequences seen below it:
+ *  - a bit already set is a duplicate
+ *  - a bit filled below the high-water mark is a reordering
+ *  - a bit still clear when it slides out of the window is a loss
+ * The signal transport carries ( generator << 24 | sequence ) in the
+ * sigqueue() value, with --sources the sources of a generator share its
+ * sequence numbers there. The socket and deque transports carry the
+ * producer and sequence in the event itself.
+ */
+#include <stdint.h>
+
+#define SEQ_TRACK_FILE   "/sequence-tracking"
+#define SEQ_MAX_SOURCES  64
+#define SEQ_WINDOW       1024
+#define SEQ_SIGNAL_BITS  24
+#define SEQ_SIGNAL_MASK  ( ( 1u << SEQ_SIGNAL_BITS ) - 1 )
+
+struct seq_stream
+{
+    uint32_t lock;
+    uint32_t active;
+    uint64_t high_water;
+    uint64_t received;
+    uint64_t duplicates;
+    uint64_t reordered;
+    uint64_t lost;
+    uint64_t window[ SEQ_WINDOW / 64 ];
+};
+
+struct seq_tracking
+{
+    struct seq_stream stream[ MAX_RX_PROCESSES ][ SEQ_MAX_SOURCES ][ 2 ];
+};
+
+extern struct seq_tracking *seq_tracking;
+
+int      seq_track_init();
+void     seq_track_remove();
+uint32_t seq_next( int type );
+void     seq_track( int consumer, uint source, int type, uint64_t seq );
+void     seq_track_print_report();
+
+#endif /* _SEQ_TRACK_H_ */
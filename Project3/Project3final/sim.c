@@ -0,0 +1,295 @@
+#include "header.h"
+#include "options.h"
+#include "event_seq.h"
+#include "seq_track.h"
+#include "stats.h"
+#include "segment.h"
+#include "sim.h"
+
+int      sim_active = 0;
+uint64_t sim_now_ns = 0;
+
+static struct sim_event *heap;
+static uint              heap_size;
+static uint              heap_capacity;
+static uint64_t          heap_order;
+static uint64_t          random_state;
+
+/**
+ * Per handler signal state, one pending signal at most
+ */
+static struct sim_handler
+{
+    int      group;
+    int      busy;
+    int      pending;
+    uint32_t source;
+    uint32_t seq;
+} handler[ RX_PROCESS_AMOUNT ];
+
+/**
+ * Returns the next value of the xorshift64* generator
+ *
+ * @return uint64_t
+ */
+static uint64_t next_random()
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+
+    return random_state * 0x2545f4914f6cdd1dull;
+}
+
+/**
+ * Returns a random value in min...max
+ *
+ * @param  uint64_t min
+ * @param  uint64_t max
+ * @return uint64_t
+ */
+static uint64_t random_between( uint64_t min, uint64_t max )
+{
+    return min + next_random() % ( max - min + 1 );
+}
+
+static int earlier( struct sim_event *a, struct sim_event *b )
+{
+    return a->at_ns < b->at_ns || ( a->at_ns == b->at_ns && a->order < b->order );
+}
+
+/**
+ * Queue an event 'delay_ns' after the current virtual time
+ *
+ * @param uint64_t delay_ns
+ * @param uint32_t kind
+ * @param uint32_t target
+ * @param uint32_t source
+ * @param uint32_t seq
+ */
+static void push( uint64_t delay_ns, uint32_t kind, uint32_t target, uint32_t source, uint32_t seq )
+{
+    if ( heap_size == heap_capacity )
+    {
+        heap_capacity = heap_capacity ? heap_capacity * 2 : 64;
+        heap = realloc( heap, heap_capacity * sizeof( struct sim_event ) );
+    }
+
+    struct sim_event event = { sim_now_ns + delay_ns, heap_order++, kind, target, source, seq };
+    uint i = heap_size++;
+
+    while ( i > 0 && earlier( &event, &heap[ ( i - 1 ) / 2 ] ) )
+    {
+        heap[i] = heap[ ( i - 1 ) / 2 ];
+        i = ( i - 1 ) / 2;
+    }
+    heap[i] = event;
+}
+
+/**
+ * Remove the earliest event into 'event'
+ *
+ * @param  struct sim_event * event
+ * @return int 0 when the queue is empty
+ */
+static int pop( struct sim_event *event )
+{
+    if ( heap_size == 0 ) return 0;
+
+    *event = heap[0];
+
+    struct sim_event last = heap[ --heap_size ];
+    uint i = 0;
+
+    for ( ;; )
+    {
+        uint child = 2 * i + 1;
+
+        if ( child >= heap_size ) break;
+        if ( child + 1 < heap_size && earlier( &heap[ child + 1 ], &heap[ child ] ) ) child++;
+        if ( !earlier( &heap[ child ], &last ) ) break;
+
+        heap[i] = heap[ child ];
+        i = child;
+    }
+    heap[i] = last;
+
+    return 1;
+}
+
+/**
+ * Returns the service time of one event of a handler
+ *
+ * @return uint64_t
+ */
+static uint64_t service_ns()
+{
+    if ( options.work == WORK_SPIN ) return (uint64_t)options.work_amount * 1000;
+
+    return random_between( SIM_SERVICE_MIN_NS, SIM_SERVICE_MAX_NS );
+}
+
+/**
+ * FNV-1a over 'length' bytes, continuing 'hash'
+ *
+ * @param  uint64_t     hash
+ * @param  const void * data
+ * @param  size_t       length
+ * @return uint64_t
+ */
+static uint64_t digest( uint64_t hash, const void *data, size_t length )
+{
+    const unsigned char *byte = data;
+
+    while ( length-- > 0 ) hash = ( hash ^ *byte++ ) * 0x100000001b3ull;
+
+    return hash;
+}
+
+/**
+ * The 'simulate' sub program: run MAX_GENERATOR_LOOP emissions of the
+ * three generators and four handlers on the virtual clock
+ *
+ * @param  uint64_t seed
+ * @return int exit status
+ */
+int simulate( uint64_t seed )
+{
+    uint32_t         seq[ TX_PROCESS_AMOUNT ][ 2 ];
+    uint64_t         coalesced = 0, events = 0;
+    uint             emissions = 0;
+    struct sim_event event;
+
+    uint64_t started = get_timestamp_ns();
+
+    sim_active      = 1;
+    sim_now_ns      = 0;
+    segment_private = 1;
+    random_state    = seed ? seed : SIM_DEFAULT_SEED;
+
+    if ( !init_counters() || !seq_track_init() || !stats_init( options.stats_window ) ) return EXIT_FAILURE;
+
+    memset( seq, 0, sizeof( seq ) );
+    memset( handler, 0, sizeof( handler ) );
+
+    // - Same slots and groups as the forked handlers
+    for ( uint slot = 0; slot < RX_PROCESS_AMOUNT; slot++ ) handler[ slot ].group = ( RX_PROCESS_AMOUNT - 1 - slot ) & 1;
+
+    for ( uint id = 0; id < TX_PROCESS_AMOUNT; id++ ) push( random_between( 10000, 99999 ) * 1000, SIM_EMIT, id, 0, 0 );
+
+    while ( pop( &event ) )
+    {
+        struct sim_handler *target = &handler[ event.target ];
+
+        sim_now_ns = event.at_ns;
+        events++;
+
+        switch ( event.kind )
+        {
+            // - Emit to both handlers of the group, sleep like get_sleep_time()
+            case SIM_EMIT:
+            {
+                if ( emissions >= MAX_GENERATOR_LOOP ) break;
+
+                int signum = next_random() % 100 < options.skew ? SIGUSR1 : SIGUSR2;
+                int type   = event_type( signum );
+
+                inc_counter( signum == SIGUSR1 ? TX_COUNTER_SIGUSR1 : TX_COUNTER_SIGUSR2 );
+                stats_record( type );
+                seq[ event.target ][ type ]++;
+
+                for ( uint slot = 0; slot < RX_PROCESS_AMOUNT; slot++ )
+                {
+                    if ( handler[ slot ].group != ( signum == SIGUSR1 ) ) continue;
+
+                    push( random_between( SIM_DELIVERY_MIN_NS, SIM_DELIVERY_MAX_NS ), SIM_DELIVER, slot, event.target, seq[ event.target ][ type ] );
+                }
+
+                emissions++;
+                push( random_between( 10000, 99999 ) * 1000, SIM_EMIT, event.target, 0, 0 );
+                break;
+            }
+
+            // - A signal already pending swallows the new one
+            case SIM_DELIVER:
+                if ( target->pending )
+                {
+                    coalesced++;
+                    break;
+                }
+
+                target->pending = 1;
+                target->source  = event.source;
+                target->seq     = event.seq;
+
+                if ( !target->busy )
+                {
+                    target->busy = 1;
+                    push( SIM_WAKEUP_NS, SIM_SERVE, event.target, 0, 0 );
+                }
+                break;
+
+            case SIM_SERVE:
+                target->pending = 0;
+
+                inc_counter( target->group == 1 ? RX_COUNTER_SIGUSR1 : RX_COUNTER_SIGUSR2 );
+                seq_track( event.target, target->source, target->group == 1 ? 0 : 1, target->seq );
+
+                push( service_ns(), SIM_IDLE, event.target, 0, 0 );
+                break;
+
+            case SIM_IDLE:
+                if ( target->pending ) push( 0, SIM_SERVE, event.target, 0, 0 );
+                else target->busy = 0;
+                break;
+        }
+    }
+
+    // ----------------------------------------
+    // - Deterministic results and their digest
+    // ----------------------------------------
+
+    int      counter[ COUNTER_AMOUNT ];
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for ( uint i = 0; i < COUNTER_AMOUNT; i++ ) counter[i] = read_counter( i );
+
+    hash = digest( hash, counter, sizeof( counter ) );
+    hash = digest( hash, &coalesced, sizeof( coalesced ) );
+    hash = digest( hash, &sim_now_ns, sizeof( sim_now_ns ) );
+    hash = digest( hash, seq_tracking, sizeof( struct seq_tracking ) );
+
+    for ( uint type = 0; type < 2; type++ )
+    {
+        struct interval_stats stats;
+
+        stats_compute( type, &stats );
+        hash = digest( hash, &stats.count, sizeof( stats.count ) );
+        hash = digest( hash, &stats.sum, sizeof( stats.sum ) );
+        hash = digest( hash, &stats.min, sizeof( stats.min ) );
+        hash = digest( hash, &stats.max, sizeof( stats.max ) );
+        hash = digest( hash, &stats.jitter_sum, sizeof( stats.jitter_sum ) );
+    }
+
+    printf( "Simulation seed %llu: %u emissions, %llu events, %.3fs virtual time\n",
+            (unsigned long long)seed, emissions, (unsigned long long)events, sim_now_ns / 1e9 );
+    printf( "Generator counter SIGUSR1: %i\nGenerator counter SIGUSR2: %i\n", counter[ TX_COUNTER_SIGUSR1 ], counter[ TX_COUNTER_SIGUSR2 ] );
+    printf( "Receiver  counter SIGUSR1: %i\nReceiver  counter SIGUSR2: %i\n", counter[ RX_COUNTER_SIGUSR1 ], counter[ RX_COUNTER_SIGUSR2 ] );
+    printf( "Coalesced signals: %llu\n", (unsigned long long)coalesced );
+
+    stats_print_report();
+    seq_track_print_report();
+
+    printf( "Digest: %016llx\n", (unsigned long long)hash );
+
+    remove_counters();
+    seq_track_remove();
+    stats_remove();
+    free( heap );
+
+    sim_active      = 0;
+    segment_private = 0;
+    fprintf( stderr, "Simulated in %.1f ms\n", ( get_timestamp_ns() - started ) / 1e6 );
+
+    return EXIT_SUCCESS;
+}
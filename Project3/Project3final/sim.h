@@ -0,0 +1,50 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+/* Description:
+ * Deterministic discrete event simulation of the signal topology.
+ * The generators, handlers and their signals are events on a virtual
+ * clock ordered by a binary heap (ties broken by insertion order), every
+ * random choice comes from one xorshift64* generator seeded by --seed.
+ * The simulation drives the real counter, interval statistics and sequence
+ * tracking code: get_timestamp_ns() returns the virtual time while it runs.
+ * The counters live in process memory and the segments are private
+ * (segment_private), a live run and its --counter-file are left alone.
+ * A handler keeps one pending signal like the kernel does for SIGUSR1 /
+ * SIGUSR2, a signal delivered while one is pending coalesces and is counted
+ * as the ground truth loss the sequence tracking must report.
+ * The run ends with a digest of the results, equal seeds give equal digests.
+ */
+#include <stdint.h>
+
+#define SIM_DEFAULT_SEED      1
+#define SIM_DELIVERY_MIN_NS   2000        /* kill() to pending */
+#define SIM_DELIVERY_MAX_NS   20000
+#define SIM_WAKEUP_NS         5000        /* sigwait() return */
+#define SIM_SERVICE_MIN_NS    1000        /* per event without --work */
+#define SIM_SERVICE_MAX_NS    10000
+
+enum sim_kind
+{
+    SIM_EMIT,                             /* generator wakes up and emits */
+    SIM_DELIVER,                          /* signal reaches a handler */
+    SIM_SERVE,                            /* handler consumes its pending signal */
+    SIM_IDLE                              /* handler finished the event */
+};
+
+struct sim_event
+{
+    uint64_t at_ns;
+    uint64_t order;
+    uint32_t kind;
+    uint32_t target;                      /* generator or handler */
+    uint32_t source;
+    uint32_t seq;
+};
+
+extern int      sim_active;
+extern uint64_t sim_now_ns;
+
+int simulate( uint64_t seed );
+
+#endif /* _SIM_H_ */
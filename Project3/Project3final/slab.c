@@ -0,0 +1,299 @@
+#include "header.h"
+#include "segment.h"
+#include "slab.h"
+
+struct slab_arena *slab_arena = NULL;
+
+/**
+ * Returns the amount of blocks of the class with payload 1 << shift
+ *
+ * @param  uint shift
+ * @return uint32_t
+ */
+static uint32_t class_blocks( uint shift )
+{
+    uint32_t blocks = SLAB_CLASS_BYTES >> shift;
+
+    return blocks < SLAB_MIN_BLOCKS ? SLAB_MIN_BLOCKS : blocks;
+}
+
+/**
+ * Returns the block at 'index' of 'size_class'
+ *
+ * @param  struct slab_class * size_class
+ * @param  uint32_t            index
+ * @return struct slab_block *
+ */
+static struct slab_block *block_at( struct slab_class *size_class, uint32_t index )
+{
+    return (struct slab_block *)( (char *)slab_arena + size_class->first + (uint64_t)index * size_class->block_size );
+}
+
+/**
+ * Create the arena segment and thread every block on its class freelist
+ *
+ * @return int
+ */
+int slab_init()
+{
+    uint64_t size = sizeof( struct slab_arena );
+
+    for ( uint shift = SLAB_MIN_SHIFT; shift <= SLAB_MAX_SHIFT; shift++ )
+    {
+        size += (uint64_t)class_blocks( shift ) * ( sizeof( struct slab_block ) + ( 1u << shift ) );
+    }
+
+    slab_arena = segment_create( SLAB_FILE, size );
+    if ( slab_arena == NULL ) return 0;
+
+    slab_arena->size = size;
+
+    uint64_t offset = sizeof( struct slab_arena );
+
+    for ( uint shift = SLAB_MIN_SHIFT; shift <= SLAB_MAX_SHIFT; shift++ )
+    {
+        struct slab_class *size_class = &slab_arena->size_class[ shift - SLAB_MIN_SHIFT ];
+
+        size_class->block_size  = sizeof( struct slab_block ) + ( 1u << shift );
+        size_class->block_count = class_blocks( shift );
+        size_class->first       = offset;
+        size_class->free_head   = 0;
+
+        for ( uint32_t i = 0; i < size_class->block_count; i++ )
+        {
+            struct slab_block *block = block_at( size_class, i );
+            block->next       = i + 1 < size_class->block_count ? i + 1 : SLAB_NONE;
+            block->size_class = shift - SLAB_MIN_SHIFT;
+        }
+
+        offset += (uint64_t)size_class->block_count * size_class->block_size;
+    }
+
+    return 1;
+}
+
+/**
+ * Remove the arena file from the os
+ */
+void slab_remove()
+{
+    segment_remove( SLAB_FILE );
+}
+
+/**
+ * Returns the class index able to hold 'length' bytes, -1 if too large
+ *
+ * @param  uint32_t length
+ * @return int
+ */
+static int class_index( uint32_t length )
+{
+    uint shift = SLAB_MIN_SHIFT;
+
+    while ( shift <= SLAB_MAX_SHIFT && ( 1u << shift ) < length ) shift++;
+
+    return shift > SLAB_MAX_SHIFT ? -1 : (int)( shift - SLAB_MIN_SHIFT );
+}
+
+/**
+ * Pop a block for 'length' payload bytes, to be released 'refs' times.
+ * Returns the offset of the payload or SLAB_NONE when the class is exhausted
+ *
+ * @param  uint32_t length
+ * @param  uint32_t refs
+ * @return uint32_t
+ */
+uint32_t slab_alloc( uint32_t length, uint32_t refs )
+{
+    int index = class_index( length );
+    if ( index < 0 || slab_arena == NULL || refs == 0 ) return SLAB_NONE;
+
+    struct slab_class *size_class = &slab_arena->size_class[ index ];
+    struct slab_block *block;
+    uint64_t head = __atomic_load_n( &size_class->free_head, __ATOMIC_ACQUIRE );
+    uint64_t next;
+
+    do
+    {
+        if ( (uint32_t)head == SLAB_NONE )
+        {
+            __atomic_add_fetch( &size_class->failures, 1, __ATOMIC_RELAXED );
+            return SLAB_NONE;
+        }
+
+        block = block_at( size_class, (uint32_t)head );
+        next  = ( ( ( head >> 32 ) + 1 ) << 32 ) | __atomic_load_n( &block->next, __ATOMIC_RELAXED );
+    }
+    while ( !__atomic_compare_exchange_n( &size_class->free_head, &head, next, 0,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) );
+
+    block->refs   = refs;
+    block->length = length;
+    __atomic_add_fetch( &size_class->allocs, 1, __ATOMIC_RELAXED );
+
+    return (uint32_t)( (char *)( block + 1 ) - (char *)slab_arena );
+}
+
+/**
+ * Returns the payload address of 'offset'
+ *
+ * @param  uint32_t offset
+ * @return void *
+ */
+void *slab_data( uint32_t offset )
+{
+    return (char *)slab_arena + offset;
+}
+
+/**
+ * Returns the payload length of 'offset'
+ *
+ * @param  uint32_t offset
+ * @return uint32_t
+ */
+uint32_t slab_length( uint32_t offset )
+{
+    return ( (struct slab_block *)slab_data( offset ) - 1 )->length;
+}
+
+/**
+ * Drop one reference of the block at 'offset',
+ * the last reference pushes it back on its class freelist
+ *
+ * @param uint32_t offset
+ */
+void slab_release( uint32_t offset )
+{
+    if ( offset == SLAB_NONE || slab_arena == NULL ) return;
+
+    struct slab_block *block = (struct slab_block *)slab_data( offset ) - 1;
+
+    if ( __atomic_sub_fetch( &block->refs, 1, __ATOMIC_ACQ_REL ) != 0 ) return;
+
+    struct slab_class *size_class = &slab_arena->size_class[ block->size_class ];
+    uint32_t index = ( (char *)block - (char *)slab_arena - size_class->first ) / size_class->block_size;
+    uint64_t head = __atomic_load_n( &size_class->free_head, __ATOMIC_ACQUIRE );
+    uint64_t next;
+
+    do
+    {
+        __atomic_store_n( &block->next, (uint32_t)head, __ATOMIC_RELAXED );
+        next = ( ( ( head >> 32 ) + 1 ) << 32 ) | index;
+    }
+    while ( !__atomic_compare_exchange_n( &size_class->free_head, &head, next, 0,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) );
+
+    __atomic_add_fetch( &size_class->frees, 1, __ATOMIC_RELAXED );
+}
+
+/**
+ * Display the allocation counters of the classes in use
+ */
+void slab_print_report()
+{
+    if ( slab_arena == NULL ) return;
+
+    for ( uint i = 0; i < SLAB_CLASS_AMOUNT; i++ )
+    {
+        struct slab_class *size_class = &slab_arena->size_class[i];
+        if ( size_class->allocs == 0 && size_class->failures == 0 ) continue;
+
+        printf( "\tPayload class %6uB: allocated %llu, freed %llu, exhausted %llu\n",
+                1u << ( i + SLAB_MIN_SHIFT ),
+                (unsigned long long)size_class->allocs,
+                (unsigned long long)size_class->frees,
+                (unsigned long long)size_class->failures );
+    }
+}
+
+/**
+ * Read every word of the payload, the way a handler consumes it
+ *
+ * @param  const unsigned char * data
+ * @param  uint32_t              length
+ * @return uint32_t
+ */
+static uint32_t payload_checksum( const unsigned char *data, uint32_t length )
+{
+    uint64_t sum = 0;
+    uint64_t word;
+    uint32_t i = 0;
+
+    for ( ; i + sizeof( word ) <= length; i += sizeof( word ) )
+    {
+        memcpy( &word, data + i, sizeof( word ) );
+        sum += word;
+    }
+
+    for ( ; i < length; i++ ) sum += data[i];
+
+    return (uint32_t)( sum ^ ( sum >> 32 ) );
+}
+
+/**
+ * Read the payload at 'offset' in place and return its byte sum
+ *
+ * @param  uint32_t offset
+ * @return uint32_t
+ */
+uint32_t slab_checksum( uint32_t offset )
+{
+    return payload_checksum( slab_data( offset ), slab_length( offset ) );
+}
+
+/**
+ * Compare the zero-copy slab path against a malloc() + memcpy() path
+ * for payload sizes from 16 B to 64 KiB, single process
+ *
+ * @return int
+ */
+int slab_benchmark()
+{
+    static unsigned char source[ 1 << SLAB_MAX_SHIFT ];
+    volatile uint32_t sink = 0;
+
+    if ( !slab_init() ) return EXIT_FAILURE;
+
+    memset( source, 0x5a, sizeof( source ) );
+
+    printf( "%8s %10s %14s %14s\n", "size", "iterations", "slab ns/event", "copy ns/event" );
+
+    for ( uint shift = SLAB_MIN_SHIFT; shift <= SLAB_MAX_SHIFT; shift++ )
+    {
+        uint32_t length = 1u << shift;
+        uint     iterations = ( 64u << 20 ) / length;
+        uint64_t start;
+
+        if ( iterations > 1000000 ) iterations = 1000000;
+
+        // - Generator fills the block in place, handler reads it in place
+        start = get_timestamp_ns();
+        for ( uint i = 0; i < iterations; i++ )
+        {
+            uint32_t offset = slab_alloc( length, 1 );
+            memset( slab_data( offset ), (unsigned char)i, length );
+            sink += slab_checksum( offset );
+            slab_release( offset );
+        }
+        uint64_t slab_ns = get_timestamp_ns() - start;
+
+        // - Baseline: fill a private buffer, copy it into a fresh allocation
+        start = get_timestamp_ns();
+        for ( uint i = 0; i < iterations; i++ )
+        {
+            unsigned char *copy = malloc( length );
+            memset( source, (unsigned char)i, length );
+            memcpy( copy, source, length );
+            sink += payload_checksum( copy, length );
+            free( copy );
+        }
+        uint64_t copy_ns = get_timestamp_ns() - start;
+
+        printf( "%8u %10u %14.1f %14.1f\n", length, iterations,
+                (double)slab_ns / iterations, (double)copy_ns / iterations );
+    }
+
+    slab_remove();
+
+    return EXIT_SUCCESS;
+}
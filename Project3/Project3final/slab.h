@@ -0,0 +1,61 @@
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+/* Description:
+ * Shared memory slab arena for event payloads.
+ * Power of two size classes from 16 B to 64 KiB, every class has its own
+ * lock-free freelist (tagged Treiber stack, the tag defeats ABA).
+ * Generators allocate a block, fill it in place and pass only its offset
+ * through the transport, handlers read it in place and release it.
+ * A block carries a reference count so the fan-out to several handlers
+ * frees it exactly once.
+ */
+#include <stdint.h>
+
+#define SLAB_FILE          "/payload-arena"
+#define SLAB_MIN_SHIFT     4                   /* 16 B   */
+#define SLAB_MAX_SHIFT     16                  /* 64 KiB */
+#define SLAB_CLASS_AMOUNT  ( SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1 )
+#define SLAB_CLASS_BYTES   ( 1 << 20 )         /* payload bytes per class */
+#define SLAB_MIN_BLOCKS    64
+#define SLAB_MAX_PAYLOAD   ( 1 << SLAB_MAX_SHIFT )
+#define SLAB_NONE          0xffffffffu
+
+struct slab_block
+{
+    uint32_t next;         /* freelist link, index within the class */
+    uint32_t refs;
+    uint32_t length;
+    uint32_t size_class;
+};
+
+struct slab_class
+{
+    uint32_t block_size;   /* header + payload capacity */
+    uint32_t block_count;
+    uint64_t first;        /* offset of block 0 from the arena base */
+    uint64_t free_head;    /* tag << 32 | index */
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+};
+
+struct slab_arena
+{
+    uint64_t          size;
+    struct slab_class size_class[ SLAB_CLASS_AMOUNT ];
+};
+
+extern struct slab_arena *slab_arena;
+
+int       slab_init();
+void      slab_remove();
+uint32_t  slab_alloc( uint32_t length, uint32_t refs );
+void     *slab_data( uint32_t offset );
+uint32_t  slab_length( uint32_t offset );
+void      slab_release( uint32_t offset );
+uint32_t  slab_checksum( uint32_t offset );
+void      slab_print_report();
+int       slab_benchmark();
+
+#endif /* _SLAB_H_ */
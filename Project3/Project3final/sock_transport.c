@@ -0,0 +1,253 @@
+#define _GNU_SOURCE     /* for sendmmsg() / recvmmsg() */
+#include "header.h"
+#include "options.h"
+#include "sock_transport.h"
+#include "slab.h"
+#include "uring.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
+
+// - Receiving sockets, created by the parent and inherited by the children
+static int                socket_fd[ MAX_RX_PROCESSES ];
+static int                socket_group[ MAX_RX_PROCESSES ];
+static struct sockaddr_un socket_address[ MAX_RX_PROCESSES ];
+static socklen_t          socket_address_length[ MAX_RX_PROCESSES ];
+
+// - Generator side batch
+static int            send_fd = -1;
+static struct event   batch[ SOCK_MAX_BATCH ];
+static uint           batch_count = 0;
+
+// - io_uring rings of this process, set up on first use
+static struct uring   send_ring    = { .fd = -1 };
+static struct uring   receive_ring = { .fd = -1 };
+
+/**
+ * Mark every socket slot unused
+ *
+ * @return int
+ */
+int sock_transport_init()
+{
+    for ( uint i = 0; i < MAX_RX_PROCESSES; i++ )
+    {
+        socket_fd[i] = -1;
+        socket_group[i] = -1;
+    }
+
+    if ( options.batch > SOCK_MAX_BATCH ) options.batch = SOCK_MAX_BATCH;
+    if ( options.batch < 1 ) options.batch = 1;
+
+    return 1;
+}
+
+/**
+ * Create the receiving socket of the handler in 'slot'
+ * bound to its abstract address
+ *
+ * @param  int slot
+ * @param  int group  signal group served
+ * @return int 0 on success
+ */
+int sock_transport_open_handler( int slot, int group )
+{
+    struct sockaddr_un *address = &socket_address[ slot ];
+
+    memset( address, 0, sizeof( *address ) );
+    address->sun_family = AF_UNIX;
+
+    // - Leading '\0' puts the name into the abstract namespace, no file to clean up
+    int length = snprintf( address->sun_path + 1, sizeof( address->sun_path ) - 1,
+                           SOCK_NAME_FORMAT, getpid(), slot );
+    socket_address_length[ slot ] = offsetof( struct sockaddr_un, sun_path ) + 1 + length;
+
+    int fd = socket( AF_UNIX, SOCK_DGRAM, 0 );
+    if ( fd == -1 ) fail( "socket()" );
+
+    if ( bind( fd, (struct sockaddr *)address, socket_address_length[ slot ] ) == -1 )
+    {
+        close( fd );
+        fail( "bind()" );
+    }
+
+    socket_fd[ slot ] = fd;
+    socket_group[ slot ] = group;
+
+    return 0;
+}
+
+/**
+ * Returns the amount of handlers receiving events of 'type'
+ *
+ * @param  int type
+ * @return uint
+ */
+uint sock_receivers( int type )
+{
+    uint count = 0;
+
+    for ( uint slot = 0; slot < MAX_RX_PROCESSES; slot++ )
+    {
+        if ( socket_fd[ slot ] != -1 && socket_group[ slot ] == ( type == 0 ) ) count++;
+    }
+
+    return count;
+}
+
+/**
+ * Queue one event of 'type', the batch is flushed when it is full.
+ * Only the offset of the payload travels through the socket
+ *
+ * @param int      type
+ * @param uint32_t payload  slab arena offset or SLAB_NONE
+ * @param uint     source   generator id
+ * @param uint32_t seq
+ */
+void sock_send( int type, uint32_t payload, uint source, uint32_t seq )
+{
+    struct event *event = &batch[ batch_count++ ];
+
+    event->type    = type;
+    event->sender  = getpid();
+    event->sent_ns = get_timestamp_ns();
+    event->payload = payload;
+    event->length  = payload == SLAB_NONE ? 0 : slab_length( payload );
+    event->source  = source;
+    event->seq     = seq;
+
+    if ( batch_count >= options.batch ) sock_flush();
+}
+
+/**
+ * Flush the batch when its oldest event would wait longer than
+ * --batch-delay at 'wake_ns', the time the generator waits until
+ *
+ * @param uint64_t wake_ns
+ */
+void sock_flush_due( uint64_t wake_ns )
+{
+    if ( batch_count == 0 ) return;
+
+    if ( wake_ns - batch[0].sent_ns >= (uint64_t)options.batch_delay_us * 1000 ) sock_flush();
+}
+
+/**
+ * Send the queued events to every interested receiver with one
+ * sendmmsg() call (or a few, if the kernel accepts a partial batch),
+ * or one io_uring submission with --uring
+ */
+void sock_flush()
+{
+    static struct mmsghdr message[ SOCK_MAX_BATCH * ( MAX_RX_PROCESSES ) ];
+    static struct iovec   vector[ SOCK_MAX_BATCH ];
+    uint count = 0;
+
+    if ( batch_count == 0 ) return;
+
+    if ( send_fd == -1 && ( send_fd = socket( AF_UNIX, SOCK_DGRAM, 0 ) ) == -1 )
+    {
+        perror( "socket()" );
+        return;
+    }
+
+    // - Map the group of the handler to the event type: group 1 serves SIGUSR1
+    for ( uint i = 0; i < batch_count; i++ )
+    {
+        vector[i].iov_base = &batch[i];
+        vector[i].iov_len  = sizeof( struct event );
+
+        for ( uint slot = 0; slot < MAX_RX_PROCESSES; slot++ )
+        {
+            if ( socket_fd[ slot ] == -1 || socket_group[ slot ] != ( batch[i].type == 0 ) ) continue;
+
+            struct msghdr *header = &message[ count++ ].msg_hdr;
+            memset( header, 0, sizeof( *header ) );
+            header->msg_name    = &socket_address[ slot ];
+            header->msg_namelen = socket_address_length[ slot ];
+            header->msg_iov     = &vector[i];
+            header->msg_iovlen  = 1;
+        }
+    }
+
+    if ( options.uring && send_ring.fd == -1 && !uring_init( &send_ring, URING_ENTRIES ) ) options.uring = 0;
+
+    if ( options.uring )
+    {
+        if ( (uint)uring_send_batch( &send_ring, send_fd, message, count ) < count ) perror( "uring_send_batch()" );
+
+        batch_count = 0;
+        return;
+    }
+
+    for ( uint sent = 0; sent < count; )
+    {
+        int result = sendmmsg( send_fd, message + sent, count - sent, 0 );
+        if ( result == -1 )
+        {
+            if ( errno == EINTR ) continue;
+            perror( "sendmmsg()" );
+            break;
+        }
+        sent += result;
+    }
+
+    batch_count = 0;
+}
+
+/**
+ * Block until at least one event is queued for 'slot' and
+ * drain up to 'max' events with one recvmmsg() call. With --uring
+ * a multishot recv stays armed and the events are reaped from the
+ * completion queue
+ *
+ * @param  int            slot
+ * @param  struct event * events
+ * @param  uint           max
+ * @return int            events received, -1 on error
+ */
+int sock_receive( int slot, struct event *events, uint max )
+{
+    struct mmsghdr message[ SOCK_MAX_BATCH ];
+    struct iovec   vector[ SOCK_MAX_BATCH ];
+
+    if ( max > SOCK_MAX_BATCH ) max = SOCK_MAX_BATCH;
+
+    if ( options.uring && receive_ring.fd == -1 )
+    {
+        if ( !uring_init( &receive_ring, URING_ENTRIES ) ||
+             !uring_arm_receive( &receive_ring, socket_fd[ slot ], sizeof( struct event ), 1 ) )
+        {
+            uring_close( &receive_ring );
+            options.uring = 0;
+        }
+    }
+
+    if ( options.uring ) return uring_receive( &receive_ring, events, max );
+
+    memset( message, 0, sizeof( message[0] ) * max );
+
+    for ( uint i = 0; i < max; i++ )
+    {
+        vector[i].iov_base = &events[i];
+        vector[i].iov_len  = sizeof( struct event );
+        message[i].msg_hdr.msg_iov    = &vector[i];
+        message[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    return recvmmsg( socket_fd[ slot ], message, max, MSG_WAITFORONE, NULL );
+}
+
+/**
+ * Flush the pending batch and close the sockets of this process
+ */
+void sock_transport_close()
+{
+    sock_flush();
+
+    if ( send_fd != -1 ) close( send_fd );
+    send_fd = -1;
+
+    if ( send_ring.fd != -1 ) uring_close( &send_ring );
+    if ( receive_ring.fd != -1 ) uring_close( &receive_ring );
+}
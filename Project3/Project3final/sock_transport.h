@@ -0,0 +1,44 @@
+#ifndef _SOCK_TRANSPORT_H_
+#define _SOCK_TRANSPORT_H_
+
+/* Description:
+ * Unix domain datagram socket transport.
+ * Every handler slot owns a socket bound in the abstract namespace.
+ * Generators queue events and flush them with one sendmmsg() call per
+ * batch, each event is addressed to every handler of its group, the same
+ * fan-out kill( 0, ... ) gives the signals. A batch is sent when it is full
+ * or, before the generator waits, when its oldest event would otherwise
+ * wait longer than --batch-delay. At the default emission rate (one event
+ * every 10...100ms per generator) a batch then holds a few events, a
+ * --batch-delay below the sleep time sends one event per sendmmsg().
+ * Handlers drain their socket with recvmmsg().
+ * With --uring both sides go through io_uring instead, see uring.h.
+ */
+#include <stdint.h>
+
+#define SOCK_NAME_FORMAT   "project3-%i-%i"
+#define SOCK_MAX_BATCH     64
+#define DEFAULT_SOCK_BATCH 32
+#define DEFAULT_SOCK_BATCH_DELAY_US 50000  /* oldest batched event waits at most */
+
+struct event
+{
+    uint32_t type;      /* 0 SIGUSR1, 1 SIGUSR2 */
+    pid_t    sender;
+    uint64_t sent_ns;
+    uint32_t payload;   /* slab arena offset, SLAB_NONE without payload */
+    uint32_t length;
+    uint32_t source;    /* generator id */
+    uint32_t seq;       /* per generator and type sequence number */
+};
+
+int  sock_transport_init();
+int  sock_transport_open_handler( int slot, int group );
+uint sock_receivers( int type );
+void sock_send( int type, uint32_t payload, uint source, uint32_t seq );
+void sock_flush();
+void sock_flush_due( uint64_t wake_ns );
+int  sock_receive( int slot, struct event *events, uint max );
+void sock_transport_close();
+
+#endif /* _SOCK_TRANSPORT_H_ */
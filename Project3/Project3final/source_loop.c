@@ -0,0 +1,171 @@
+#include <math.h>
+#include <sys/epoll.h>
+#include "header.h"
+#include "options.h"
+#include "registry.h"
+#include "sock_transport.h"
+#include "source_loop.h"
+
+// - Per generator, the generator threads of --threads each run their own wheel
+static __thread struct source *sources;
+static __thread uint32_t       wheel[ WHEEL_SLOTS ];
+static __thread uint64_t       tick;
+
+/**
+ * Returns the next value of the source's xorshift generator
+ *
+ * @param  struct source * source
+ * @return uint64_t
+ */
+static uint64_t next_random( struct source *source )
+{
+    source->random ^= source->random << 13;
+    source->random ^= source->random >> 7;
+    source->random ^= source->random << 17;
+
+    return source->random;
+}
+
+/**
+ * Put source 'index' on the wheel 'delay_us' from now, at least one tick
+ *
+ * @param uint32_t index
+ * @param uint64_t delay_us
+ */
+static void schedule( uint32_t index, uint64_t delay_us )
+{
+    uint64_t ticks = delay_us * 1000 / WHEEL_TICK_NS;
+    if ( ticks == 0 ) ticks = 1;
+
+    uint32_t slot = ( tick + ticks ) & ( WHEEL_SLOTS - 1 );
+
+    sources[ index ].rounds = ( ticks - 1 ) / WHEEL_SLOTS;
+    sources[ index ].next   = wheel[ slot ];
+    wheel[ slot ] = index;
+}
+
+/**
+ * Returns an exponential inter-arrival time of the source in microseconds
+ *
+ * @param  struct source * source
+ * @return uint64_t
+ */
+static uint64_t arrival_us( struct source *source )
+{
+    double uniform = ( ( next_random( source ) >> 11 ) + 1 ) * ( 1.0 / 9007199254740992.0 );
+
+    return (uint64_t)( -log( uniform ) * source->mean_us );
+}
+
+/**
+ * Advance the wheel by one tick, emitting for every source due
+ *
+ * @param  int  id
+ * @param  uint count
+ * @return uint events emitted
+ */
+static uint advance( int id, uint count )
+{
+    uint32_t slot  = ++tick & ( WHEEL_SLOTS - 1 );
+    uint32_t index = wheel[ slot ];
+    uint     emitted = 0;
+
+    // - Detach the slot, the sources not due yet go back with one turn less
+    wheel[ slot ] = SOURCE_NONE;
+
+    while ( index != SOURCE_NONE )
+    {
+        struct source *source = &sources[ index ];
+        uint32_t       next   = source->next;
+
+        if ( source->rounds > 0 )
+        {
+            source->rounds--;
+            source->next = wheel[ slot ];
+            wheel[ slot ] = index;
+        }
+        else if ( total_emissions++ < MAX_GENERATOR_LOOP )
+        {
+            int signum = get_random_signum() ? SIGUSR1 : SIGUSR2;
+
+            emit_event( id * count + index, signum, ++source->seq[ signum == SIGUSR2 ] );
+            schedule( index, arrival_us( source ) );
+            emitted++;
+        }
+
+        index = next;
+    }
+
+    return emitted;
+}
+
+/**
+ * Generator loop of 'count' virtual sources, returns once the process
+ * reached MAX_GENERATOR_LOOP emissions or the loop got stopped
+ *
+ * @param  int  id
+ * @param  uint count
+ * @return int  0 on success, -1 on a timer failure
+ */
+int source_loop( int id, uint count )
+{
+    struct itimerspec  interval = { { 0, WHEEL_TICK_NS }, { 0, WHEEL_TICK_NS } };
+    struct epoll_event event = { .events = EPOLLIN };
+    uint64_t           expirations;
+
+    sources = calloc( count, sizeof( struct source ) );
+    if ( sources == NULL ) return -1;
+
+    struct metric *sources_metric = metric_register( METRIC_GAUGE, "generator.sources" );
+    struct metric *ticks_metric   = metric_register( METRIC_HISTOGRAM, "generator.wheel_ticks" );
+    struct metric *events_metric  = metric_register( METRIC_HISTOGRAM, "generator.wheel_events" );
+
+    // - Every source gets its own generator state and mean arrival time
+    for ( uint32_t i = 0; i < WHEEL_SLOTS; i++ ) wheel[i] = SOURCE_NONE;
+
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+        sources[i].random  = ( (uint64_t)getpid() << 40 ) ^ ( (uint64_t)id << 32 ) ^ ( ( i + 1 ) * 0x9e3779b97f4a7c15ull );
+        sources[i].mean_us = SOURCE_MIN_MEAN_US + next_random( &sources[i] ) % ( SOURCE_MAX_MEAN_US - SOURCE_MIN_MEAN_US );
+        schedule( i, arrival_us( &sources[i] ) );
+    }
+
+    int timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+    int epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+
+    if ( timer_fd == -1 || epoll_fd == -1
+         || epoll_ctl( epoll_fd, EPOLL_CTL_ADD, timer_fd, &event ) == -1
+         || timerfd_settime( timer_fd, 0, &interval, NULL ) == -1 )
+    {
+        perror( "source_loop()" );
+        return -1;
+    }
+
+    metric_add( sources_metric, count );
+    printf( "\tGenerator %i (pid %i) runs %u sources on a %i slot timer wheel\n", id, getpid(), count, WHEEL_SLOTS );
+
+    while ( child_loop && total_emissions < MAX_GENERATOR_LOOP )
+    {
+        if ( epoll_wait( epoll_fd, &event, 1, -1 ) != 1 ) continue;
+        if ( read( timer_fd, &expirations, sizeof( expirations ) ) != sizeof( expirations ) ) continue;
+
+        uint emitted = 0;
+
+        // - Catch up the ticks missed while emitting
+        for ( uint64_t i = 0; i < expirations; i++ ) emitted += advance( id, count );
+
+        // - Send the partial socket batch before it waits past --batch-delay
+        sock_flush_due( get_timestamp_ns() + WHEEL_TICK_NS );
+
+        metric_observe( ticks_metric, expirations );
+        metric_observe( events_metric, emitted );
+    }
+
+    metric_add( sources_metric, -(int64_t)count );
+
+    close( epoll_fd );
+    close( timer_fd );
+    free( sources );
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef _SOURCE_LOOP_H_
+#define _SOURCE_LOOP_H_
+
+/* Description:
+ * Event loop generator multiplexing many virtual sources in one process.
+ * Every source draws exponential inter-arrival times around its own mean
+ * (picked in 10...100 ms, the range of get_sleep_time()) from its own
+ * xorshift state and numbers its emissions per signal type. The sources
+ * wait on a hashed timer wheel of WHEEL_SLOTS 1 ms ticks, a source due
+ * further than one turn away keeps a count of the turns left. A single
+ * periodic timerfd, waited on with epoll, advances the wheel; ticks missed
+ * while emitting are caught up on the next wakeup.
+ * Source 'k' of generator 'id' emits as source id * n + k. The socket and
+ * deque events carry that id and the sequence of the source, --sequence
+ * then needs generators * n <= SEQ_MAX_SOURCES (checked in options.c). A
+ * signal value only has room for the generator id, the sources of a
+ * generator share its sequence numbers there, without a bound on n.
+ */
+#include <stdint.h>
+
+#define WHEEL_SLOTS       1024        /* power of two */
+#define WHEEL_TICK_NS     1000000
+#define SOURCE_MIN_MEAN_US 10000
+#define SOURCE_MAX_MEAN_US 100000
+#define SOURCE_NONE       UINT32_MAX
+
+struct source
+{
+    uint32_t next;                    /* in the wheel slot */
+    uint32_t rounds;                  /* wheel turns left */
+    uint32_t mean_us;
+    uint32_t seq[ 2 ];
+    uint64_t random;                  /* xorshift state */
+};
+
+int source_loop( int id, uint count );
+
+#endif /* _SOURCE_LOOP_H_ */
@@ -0,0 +1,30 @@
+#ifndef _SPINLOCK_H_
+#define _SPINLOCK_H_
+
+/* Description:
+ * Test-and-set spinlock for short critical sections in shared memory,
+ * yields the cpu every 100 spins in case the holder got preempted
+ */
+#include <sched.h>
+#include <stdint.h>
+
+static inline void spin_lock( uint32_t *lock )
+{
+    uint spins = 0;
+
+    while ( __atomic_exchange_n( lock, 1, __ATOMIC_ACQUIRE ) )
+    {
+        while ( __atomic_load_n( lock, __ATOMIC_RELAXED ) )
+        {
+            if ( ++spins % 100 == 0 ) sched_yield();
+            else cpu_relax();
+        }
+    }
+}
+
+static inline void spin_unlock( uint32_t *lock )
+{
+    __atomic_store_n( lock, 0, __ATOMIC_RELEASE );
+}
+
+#endif /* _SPINLOCK_H_ */
@@ -0,0 +1,522 @@
+#include "header.h"
+#include "segment.h"
+#include "stats.h"
+#include <math.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define STATS_X86 1
+#endif
+
+struct timestamp_rings *timestamp_rings = NULL;
+static size_t           rings_size = 0;
+
+/**
+ * Create the timestamp rings of 'capacity' entries per signal type
+ *
+ * @param  uint64_t capacity
+ * @return int
+ */
+int stats_init( uint64_t capacity )
+{
+    if ( capacity < STATS_MIN_WINDOW ) capacity = STATS_MIN_WINDOW;
+
+    rings_size = sizeof( struct timestamp_rings ) + 2 * capacity * sizeof( uint64_t );
+
+    timestamp_rings = segment_create( STATS_FILE, rings_size );
+    if ( timestamp_rings == NULL ) return 0;
+
+    timestamp_rings->capacity = capacity;
+
+    for ( uint type = 0; type < 2; type++ )
+    {
+        timestamp_rings->ring[ type ].offset = sizeof( struct timestamp_rings ) + type * capacity * sizeof( uint64_t );
+    }
+
+    return 1;
+}
+
+/**
+ * Remove the timestamp file from the os
+ */
+void stats_remove()
+{
+    segment_remove( STATS_FILE );
+}
+
+static uint64_t *ring_data( int type )
+{
+    return (uint64_t *)( (char *)timestamp_rings + timestamp_rings->ring[ type ].offset );
+}
+
+/**
+ * Append the current time to the ring of 'type'
+ *
+ * @param int type
+ */
+void stats_record( int type )
+{
+    if ( timestamp_rings == NULL ) return;
+
+    uint64_t index = __atomic_fetch_add( &timestamp_rings->ring[ type ].head, 1, __ATOMIC_ACQ_REL );
+
+    ring_data( type )[ index % timestamp_rings->capacity ] = get_timestamp_ns();
+}
+
+/**
+ * Returns the newest emission time of 'type', 0 before the first one
+ *
+ * @param  int type
+ * @return uint64_t
+ */
+uint64_t stats_latest( int type )
+{
+    if ( timestamp_rings == NULL ) return 0;
+
+    uint64_t head = __atomic_load_n( &timestamp_rings->ring[ type ].head, __ATOMIC_ACQUIRE );
+    if ( head == 0 ) return 0;
+
+    return __atomic_load_n( &ring_data( type )[ ( head - 1 ) % timestamp_rings->capacity ], __ATOMIC_RELAXED );
+}
+
+// --------------------------------------------------------------------------------
+// -
+// - Interval kernels, accumulate the intervals and jitters inside one
+// - contiguous span of timestamps
+// -
+// --------------------------------------------------------------------------------
+
+/**
+ * Scalar kernel, also finishes the tails of the vector kernels
+ *
+ * @param const uint64_t *        t
+ * @param size_t                  n
+ * @param struct interval_stats * stats
+ */
+static void kernel_scalar( const uint64_t *t, size_t n, struct interval_stats *stats )
+{
+    if ( n < 2 ) return;
+
+    for ( size_t i = 0; i + 1 < n; i++ )
+    {
+        int64_t d = t[ i + 1 ] - t[i];
+
+        stats->sum_sq += (double)d * d;
+        if ( d < stats->min ) stats->min = d;
+        if ( d > stats->max ) stats->max = d;
+
+        if ( i + 2 < n )
+        {
+            int64_t j = (int64_t)( t[ i + 2 ] - t[ i + 1 ] ) - d;
+            stats->jitter_sum += j < 0 ? -j : j;
+        }
+    }
+
+    stats->count        += n - 1;
+    stats->sum          += t[ n - 1 ] - t[0];
+    stats->jitter_count += n - 2;
+}
+
+#ifdef STATS_X86
+
+// - 1.5 * 2^52 as a double: adding an integer in [-2^51, 2^51) to its bits
+// - and subtracting it converts int64 -> double without AVX-512. The offset
+// - keeps negative intervals (timestamps stored out of order) in range
+#define MAGIC_BITS 0x4338000000000000ll
+
+/**
+ * AVX2 kernel, four intervals per iteration
+ */
+__attribute__(( target( "avx2" ) ))
+static void kernel_avx2( const uint64_t *t, size_t n, struct interval_stats *stats )
+{
+    __m256i minimum = _mm256_set1_epi64x( stats->min );
+    __m256i maximum = _mm256_set1_epi64x( stats->max );
+    __m256i jitter  = _mm256_setzero_si256();
+    __m256i magic_i = _mm256_set1_epi64x( MAGIC_BITS );
+    __m256d magic_d = _mm256_castsi256_pd( magic_i );
+    __m256d squares = _mm256_setzero_pd();
+    __m256i zero    = _mm256_setzero_si256();
+    size_t  i = 0;
+
+    if ( n < 2 ) return;
+
+    for ( ; i + 5 < n; i += 4 )
+    {
+        __m256i a = _mm256_loadu_si256( (const __m256i *)( t + i ) );
+        __m256i b = _mm256_loadu_si256( (const __m256i *)( t + i + 1 ) );
+        __m256i c = _mm256_loadu_si256( (const __m256i *)( t + i + 2 ) );
+        __m256i d = _mm256_sub_epi64( b, a );
+        __m256i j = _mm256_sub_epi64( _mm256_sub_epi64( c, b ), d );
+        __m256i s = _mm256_cmpgt_epi64( zero, j );
+
+        minimum = _mm256_blendv_epi8( minimum, d, _mm256_cmpgt_epi64( minimum, d ) );
+        maximum = _mm256_blendv_epi8( maximum, d, _mm256_cmpgt_epi64( d, maximum ) );
+        jitter  = _mm256_add_epi64( jitter, _mm256_sub_epi64( _mm256_xor_si256( j, s ), s ) );
+
+        __m256d f = _mm256_sub_pd( _mm256_castsi256_pd( _mm256_add_epi64( d, magic_i ) ), magic_d );
+        squares = _mm256_add_pd( squares, _mm256_mul_pd( f, f ) );
+    }
+
+    int64_t lane_min[4], lane_max[4], lane_jitter[4];
+    double  lane_squares[4];
+
+    _mm256_storeu_si256( (__m256i *)lane_min, minimum );
+    _mm256_storeu_si256( (__m256i *)lane_max, maximum );
+    _mm256_storeu_si256( (__m256i *)lane_jitter, jitter );
+    _mm256_storeu_pd( lane_squares, squares );
+
+    for ( uint lane = 0; lane < 4; lane++ )
+    {
+        if ( lane_min[ lane ] < stats->min ) stats->min = lane_min[ lane ];
+        if ( lane_max[ lane ] > stats->max ) stats->max = lane_max[ lane ];
+        stats->jitter_sum += lane_jitter[ lane ];
+        stats->sum_sq     += lane_squares[ lane ];
+    }
+
+    stats->count        += i;
+    stats->jitter_count += i;
+    stats->sum          += t[i] - t[0];
+
+    // - The tail starts at the last timestamp the vector loop reached
+    kernel_scalar( t + i, n - i, stats );
+}
+
+/**
+ * SSE4.2 kernel, two intervals per iteration
+ */
+__attribute__(( target( "sse4.2" ) ))
+static void kernel_sse( const uint64_t *t, size_t n, struct interval_stats *stats )
+{
+    __m128i minimum = _mm_set1_epi64x( stats->min );
+    __m128i maximum = _mm_set1_epi64x( stats->max );
+    __m128i jitter  = _mm_setzero_si128();
+    __m128i magic_i = _mm_set1_epi64x( MAGIC_BITS );
+    __m128d magic_d = _mm_castsi128_pd( magic_i );
+    __m128d squares = _mm_setzero_pd();
+    __m128i zero    = _mm_setzero_si128();
+    size_t  i = 0;
+
+    if ( n < 2 ) return;
+
+    for ( ; i + 3 < n; i += 2 )
+    {
+        __m128i a = _mm_loadu_si128( (const __m128i *)( t + i ) );
+        __m128i b = _mm_loadu_si128( (const __m128i *)( t + i + 1 ) );
+        __m128i c = _mm_loadu_si128( (const __m128i *)( t + i + 2 ) );
+        __m128i d = _mm_sub_epi64( b, a );
+        __m128i j = _mm_sub_epi64( _mm_sub_epi64( c, b ), d );
+        __m128i s = _mm_cmpgt_epi64( zero, j );
+
+        minimum = _mm_blendv_epi8( minimum, d, _mm_cmpgt_epi64( minimum, d ) );
+        maximum = _mm_blendv_epi8( maximum, d, _mm_cmpgt_epi64( d, maximum ) );
+        jitter  = _mm_add_epi64( jitter, _mm_sub_epi64( _mm_xor_si128( j, s ), s ) );
+
+        __m128d f = _mm_sub_pd( _mm_castsi128_pd( _mm_add_epi64( d, magic_i ) ), magic_d );
+        squares = _mm_add_pd( squares, _mm_mul_pd( f, f ) );
+    }
+
+    int64_t lane_min[2], lane_max[2], lane_jitter[2];
+    double  lane_squares[2];
+
+    _mm_storeu_si128( (__m128i *)lane_min, minimum );
+    _mm_storeu_si128( (__m128i *)lane_max, maximum );
+    _mm_storeu_si128( (__m128i *)lane_jitter, jitter );
+    _mm_storeu_pd( lane_squares, squares );
+
+    for ( uint lane = 0; lane < 2; lane++ )
+    {
+        if ( lane_min[ lane ] < stats->min ) stats->min = lane_min[ lane ];
+        if ( lane_max[ lane ] > stats->max ) stats->max = lane_max[ lane ];
+        stats->jitter_sum += lane_jitter[ lane ];
+        stats->sum_sq     += lane_squares[ lane ];
+    }
+
+    stats->count        += i;
+    stats->jitter_count += i;
+    stats->sum          += t[i] - t[0];
+
+    kernel_scalar( t + i, n - i, stats );
+}
+
+#endif /* STATS_X86 */
+
+/**
+ * Pick the widest kernel the cpu supports, once
+ *
+ * @return stats_kernel
+ */
+static stats_kernel select_kernel()
+{
+    static stats_kernel kernel = NULL;
+
+    if ( kernel ) return kernel;
+
+    kernel = kernel_scalar;
+
+#ifdef STATS_X86
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" ) ) kernel = kernel_avx2;
+    else if ( __builtin_cpu_supports( "sse4.2" ) ) kernel = kernel_sse;
+#endif
+
+    return kernel;
+}
+
+/**
+ * Returns the name of the kernel in use
+ *
+ * @return const char *
+ */
+const char *stats_kernel_name()
+{
+    stats_kernel kernel = select_kernel();
+
+#ifdef STATS_X86
+    if ( kernel == kernel_avx2 ) return "avx2";
+    if ( kernel == kernel_sse ) return "sse4.2";
+#endif
+
+    return kernel == kernel_scalar ? "scalar" : "unknown";
+}
+
+/**
+ * Reset the accumulator
+ *
+ * @param struct interval_stats * stats
+ */
+static void stats_reset( struct interval_stats *stats )
+{
+    memset( stats, 0, sizeof( *stats ) );
+
+    stats->min = INT64_MAX;
+    stats->max = INT64_MIN;
+}
+
+/**
+ * Compute the interval statistics over the ring of 'type'. A wrapped ring
+ * is two spans, the interval and jitters across the seam are added here
+ *
+ * @param int                     type
+ * @param struct interval_stats * stats
+ */
+void stats_compute( int type, struct interval_stats *stats )
+{
+    stats_kernel kernel = select_kernel();
+
+    stats_reset( stats );
+    if ( timestamp_rings == NULL ) return;
+
+    uint64_t  capacity = timestamp_rings->capacity;
+    uint64_t  head     = __atomic_load_n( &timestamp_rings->ring[ type ].head, __ATOMIC_ACQUIRE );
+    uint64_t *data     = ring_data( type );
+
+    if ( head <= STATS_GUARD ) return;
+
+    // - Skip the newest slots still being written and the oldest ones
+    // - the next appends overwrite
+    uint64_t end   = head - STATS_GUARD;
+    uint64_t start = head > capacity ? head - capacity + STATS_GUARD : 0;
+    size_t   first = start % capacity;
+    size_t   count = end - start;
+
+    if ( first + count <= capacity )
+    {
+        kernel( data + first, count, stats );
+        return;
+    }
+
+    size_t a = capacity - first;
+    size_t b = count - a;
+
+    kernel( data + first, a, stats );
+    kernel( data, b, stats );
+
+    // - Seam between data[ capacity - 1 ] and data[0]
+    int64_t seam = data[0] - data[ capacity - 1 ];
+
+    stats->count++;
+    stats->sum    += seam;
+    stats->sum_sq += (double)seam * seam;
+    if ( seam < stats->min ) stats->min = seam;
+    if ( seam > stats->max ) stats->max = seam;
+
+    if ( a >= 2 )
+    {
+        int64_t j = seam - (int64_t)( data[ capacity - 1 ] - data[ capacity - 2 ] );
+        stats->jitter_sum += j < 0 ? -j : j;
+        stats->jitter_count++;
+    }
+    if ( b >= 2 )
+    {
+        int64_t j = (int64_t)( data[1] - data[0] ) - seam;
+        stats->jitter_sum += j < 0 ? -j : j;
+        stats->jitter_count++;
+    }
+}
+
+/**
+ * Display the interval statistics of both signal types
+ */
+void stats_print_report()
+{
+    struct interval_stats stats;
+
+    if ( timestamp_rings == NULL ) return;
+
+    for ( uint type = 0; type < 2; type++ )
+    {
+        stats_compute( type, &stats );
+        if ( stats.count < 2 ) continue;
+
+        double mean     = (double)stats.sum / stats.count;
+        double variance = ( stats.sum_sq - mean * stats.sum ) / ( stats.count - 1 );
+
+        printf( "\t%s intervals (%s, %llu): mean %.0fus, stddev %.0fus, min %lldus, max %lldus, jitter %.0fus\n",
+                type == 0 ? "SIGUSR1" : "SIGUSR2", stats_kernel_name(),
+                (unsigned long long)stats.count, mean / 1000,
+                variance > 0 ? sqrt( variance ) / 1000 : 0.0,
+                (long long)stats.min / 1000, (long long)stats.max / 1000,
+                stats.jitter_count ? (double)stats.jitter_sum / stats.jitter_count / 1000 : 0.0 );
+    }
+}
+
+/**
+ * Returns 1 when the kernel result 'stats' matches the scalar 'reference',
+ * the sum of squares only up to the rounding of another summation order
+ *
+ * @param  const struct interval_stats * stats
+ * @param  const struct interval_stats * reference
+ * @return int
+ */
+static int stats_equal( const struct interval_stats *stats, const struct interval_stats *reference )
+{
+    return stats->count == reference->count && stats->sum == reference->sum
+           && stats->min == reference->min && stats->max == reference->max
+           && stats->jitter_sum == reference->jitter_sum
+           && stats->jitter_count == reference->jitter_count
+           && fabs( stats->sum_sq - reference->sum_sq ) <= 1e-9 * reference->sum_sq;
+}
+
+/**
+ * Time every kernel available on this cpu over a synthetic ring,
+ * reports timestamps per second and checks them against the scalar result
+ *
+ * @return int
+ */
+int stats_benchmark()
+{
+    const size_t count = 1 << 22;
+    const uint   rounds = 20;
+    struct { const char *name; stats_kernel kernel; int supported; } kernels[] =
+    {
+        { "scalar", kernel_scalar, 1 },
+#ifdef STATS_X86
+        { "sse4.2", kernel_sse,  __builtin_cpu_supports( "sse4.2" ) },
+        { "avx2",   kernel_avx2, __builtin_cpu_supports( "avx2" ) },
+#endif
+    };
+    struct interval_stats reference, stats;
+
+    uint64_t *t = malloc( count * sizeof( uint64_t ) );
+    if ( t == NULL ) fail( "malloc()" );
+
+    t[0] = get_timestamp_ns();
+    for ( size_t i = 1; i < count; i++ ) t[i] = t[ i - 1 ] + 10000 + rand() % 90000;
+
+    stats_reset( &reference );
+    kernel_scalar( t, count, &reference );
+
+    printf( "%8s %16s %8s\n", "kernel", "timestamps/s", "result" );
+
+    for ( uint k = 0; k < sizeof( kernels ) / sizeof( kernels[0] ); k++ )
+    {
+        if ( !kernels[k].supported ) continue;
+
+        uint64_t start = get_timestamp_ns();
+        for ( uint r = 0; r < rounds; r++ )
+        {
+            stats_reset( &stats );
+            kernels[k].kernel( t, count, &stats );
+        }
+        uint64_t elapsed = get_timestamp_ns() - start;
+
+        printf( "%8s %16.0f %8s\n", kernels[k].name, (double)count * rounds * 1e9 / elapsed,
+                stats_equal( &stats, &reference ) ? "ok" : "MISMATCH" );
+    }
+
+    free( t );
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Check every kernel available on this cpu against the scalar kernel over
+ * spans of every length up to 64 (all the vector tails) and one long span,
+ * with timestamps stored out of order: a generator preempted between
+ * claiming its slot and writing the time leaves a negative interval
+ *
+ * @return int EXIT_FAILURE on any mismatch
+ */
+int stats_test()
+{
+    const size_t count = 4096;
+    struct { const char *name; stats_kernel kernel; int supported; } kernels[] =
+    {
+        { "scalar", kernel_scalar, 1 },
+#ifdef STATS_X86
+        { "sse4.2", kernel_sse,  __builtin_cpu_supports( "sse4.2" ) },
+        { "avx2",   kernel_avx2, __builtin_cpu_supports( "avx2" ) },
+#endif
+    };
+    struct interval_stats reference, stats;
+    uint failures = 0;
+
+    uint64_t *t = malloc( count * sizeof( uint64_t ) );
+    if ( t == NULL ) fail( "malloc()" );
+
+    srand( 1 );
+    t[0] = get_timestamp_ns();
+    for ( size_t i = 1; i < count; i++ ) t[i] = t[ i - 1 ] + 10000 + rand() % 90000;
+
+    // - Swap neighbours every few slots, the first pair inside every span
+    for ( size_t i = 0; i + 1 < count; i += 7 )
+    {
+        uint64_t swap = t[i];
+        t[i] = t[ i + 1 ];
+        t[ i + 1 ] = swap;
+    }
+
+    for ( size_t n = 2; n <= 65; n++ )
+    {
+        size_t length = n == 65 ? count : n;
+
+        stats_reset( &reference );
+        kernel_scalar( t, length, &reference );
+
+        if ( reference.min >= 0 ) fail( "stats-test input without a negative interval" );
+
+        for ( uint k = 1; k < sizeof( kernels ) / sizeof( kernels[0] ); k++ )
+        {
+            if ( !kernels[k].supported ) continue;
+
+            stats_reset( &stats );
+            kernels[k].kernel( t, length, &stats );
+
+            if ( stats_equal( &stats, &reference ) ) continue;
+
+            printf( "%s: MISMATCH over %zu timestamps, sum_sq %g instead of %g\n",
+                    kernels[k].name, length, stats.sum_sq, reference.sum_sq );
+            failures++;
+        }
+    }
+
+    free( t );
+
+    for ( uint k = 1; k < sizeof( kernels ) / sizeof( kernels[0] ); k++ )
+    {
+        printf( "%8s %s\n", kernels[k].name, !kernels[k].supported ? "unsupported" : failures ? "FAILED" : "ok" );
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,57 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/* Description:
+ * Streaming emission statistics.
+ * Generators append the emission time of every event to a shared memory
+ * ring per signal type (up to millions of 64-bit timestamps). The reporter
+ * computes the interval mean, variance, min / max and jitter (mean absolute
+ * difference of consecutive intervals) over the whole ring with a SIMD
+ * kernel picked at runtime: AVX2, SSE4.2 or the scalar fallback.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_FILE           "/timestamps"
+#define DEFAULT_STATS_WINDOW ( 1 << 20 )  /* timestamps per signal type */
+#define STATS_GUARD          8        /* newest slots may still be written */
+#define STATS_MIN_WINDOW     1024
+
+struct interval_stats
+{
+    uint64_t count;
+    int64_t  sum;
+    double   sum_sq;
+    int64_t  min;
+    int64_t  max;
+    int64_t  jitter_sum;
+    uint64_t jitter_count;
+};
+
+struct timestamp_ring
+{
+    uint64_t head;                    /* total appended */
+    uint64_t offset;                  /* of the data from the segment base */
+};
+
+struct timestamp_rings
+{
+    uint64_t              capacity;
+    struct timestamp_ring ring[ 2 ];
+};
+
+typedef void ( *stats_kernel )( const uint64_t *timestamps, size_t count, struct interval_stats *stats );
+
+extern struct timestamp_rings *timestamp_rings;
+
+int         stats_init( uint64_t capacity );
+void        stats_remove();
+void        stats_record( int type );
+uint64_t    stats_latest( int type );
+const char *stats_kernel_name();
+void        stats_compute( int type, struct interval_stats *stats );
+void        stats_print_report();
+int         stats_benchmark();
+int         stats_test();
+
+#endif /* _STATS_H_ */
@@ -0,0 +1,364 @@
+#include "header.h"
+#include "options.h"
+#include "sweep.h"
+#include <sys/prctl.h>
+
+static struct sweep_axis axis[ AXIS_COUNT ] =
+{
+    { "generators", { "3" },      1 },
+    { "handlers",   { "4" },      1 },
+    { "sources",    { "0" },      1 },
+    { "transport",  { "signal" }, 1 },
+    { "counters",   { "shm" },    1 },
+    { "lock",       { "mutex" },  1 }
+};
+
+/**
+ * Split the comma separated 'values' into the axis, in place
+ *
+ * @param  struct sweep_axis * axis
+ * @param  char *              values
+ * @return int 0 on too many values
+ */
+static int parse_axis( struct sweep_axis *axis, char *values )
+{
+    axis->count = 0;
+
+    for ( char *value = strtok( values, "," ); value; value = strtok( NULL, "," ) )
+    {
+        if ( axis->count == SWEEP_MAX_VALUES ) return 0;
+        axis->value[ axis->count++ ] = value;
+    }
+
+    return axis->count > 0;
+}
+
+/**
+ * Sleep 'seconds', resuming after signals
+ *
+ * @param double seconds
+ */
+static void sleep_seconds( double seconds )
+{
+    struct timespec left = { (time_t)seconds, (long)( ( seconds - (time_t)seconds ) * 1e9 ) };
+
+    while ( nanosleep( &left, &left ) == -1 && errno == EINTR );
+}
+
+/**
+ * Returns the user + system time of the reaped descendants
+ *
+ * @return double seconds
+ */
+static double children_cpu()
+{
+    struct rusage usage;
+    getrusage( RUSAGE_CHILDREN, &usage );
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1e6;
+}
+
+/**
+ * Read the "key=value" summary written by the run
+ *
+ * @param  const char *          path
+ * @param  struct sweep_result * result
+ * @return int 0 when the run left no summary
+ */
+static int read_summary( const char *path, struct sweep_result *result )
+{
+    char               line[ 128 ], key[ 32 ];
+    unsigned long long value;
+
+    FILE *file = fopen( path, "r" );
+    if ( file == NULL ) return 0;
+
+    while ( fgets( line, sizeof( line ), file ) )
+    {
+        // - Skip the non numeric entries
+        if ( sscanf( line, "%31[^=]=%llu", key, &value ) != 2 ) continue;
+
+        if ( strcmp( key, "emitted" ) == 0 ) result->emitted = value;
+        else if ( strcmp( key, "received" ) == 0 ) result->received = value;
+        else if ( strcmp( key, "expected" ) == 0 ) result->expected = value;
+        else if ( strcmp( key, "latency_p50_ns" ) == 0 ) result->latency_p50_ns = value;
+        else if ( strcmp( key, "latency_p90_ns" ) == 0 ) result->latency_p90_ns = value;
+        else if ( strcmp( key, "latency_p99_ns" ) == 0 ) result->latency_p99_ns = value;
+    }
+
+    fclose( file );
+
+    return 1;
+}
+
+/**
+ * Run one cell in a fresh session for 'seconds', then interrupt it and
+ * reap the whole tree
+ *
+ * @param  const char **         cell      axis values
+ * @param  char **               forwarded "--option" arguments, NULL terminated
+ * @param  double                seconds
+ * @param  struct sweep_result * result
+ * @return int 0 when the run failed
+ */
+static int run_cell( const char **cell, char **forwarded, double seconds, struct sweep_result *result )
+{
+    char  option[ AXIS_COUNT + 2 ][ 96 ];
+    char *args[ 64 ];
+    char  summary[ 64 ], counters[ 64 ];
+    uint  count = 0;
+    int   status;
+
+    snprintf( summary, sizeof( summary ), SWEEP_SUMMARY, getpid() );
+    snprintf( counters, sizeof( counters ), SWEEP_COUNTERS, getpid() );
+
+    unlink( summary );
+    unlink( counters );
+
+    args[ count++ ] = "app";
+    snprintf( option[0], sizeof( option[0] ), "--generators=%s", cell[ AXIS_GENERATORS ] );
+    snprintf( option[1], sizeof( option[1] ), "--handlers=%s", cell[ AXIS_HANDLERS ] );
+    snprintf( option[2], sizeof( option[2] ), "--sources=%s", cell[ AXIS_SOURCES ] );
+    snprintf( option[3], sizeof( option[3] ), "--transport=%s", cell[ AXIS_TRANSPORT ] );
+    snprintf( option[4], sizeof( option[4] ), "--summary=%s", summary );
+    snprintf( option[5], sizeof( option[5] ), "--counter-file=%s", counters );
+    snprintf( option[6], sizeof( option[6] ), "--lock=%s", cell[ AXIS_LOCK ] );
+
+    for ( uint i = 0; i < 5; i++ ) args[ count++ ] = option[i];
+    args[ count++ ] = option[6];
+    if ( strcmp( cell[ AXIS_COUNTERS ], "file" ) == 0 ) args[ count++ ] = option[5];
+
+    for ( uint i = 0; forwarded[i] && count < 63; i++ ) args[ count++ ] = forwarded[i];
+    args[ count ] = NULL;
+
+    double   cpu = children_cpu();
+    uint64_t started = get_timestamp_ns();
+
+    fflush( stdout );
+    pid_t pid = fork();
+    if ( pid == -1 ) return 0;
+
+    if ( pid == 0 )
+    {
+        int null = open( "/dev/null", O_WRONLY );
+
+        setsid();
+        dup2( null, STDOUT_FILENO );
+        dup2( null, STDERR_FILENO );
+
+        // - Every run starts from zero, no leftover segments to resume
+        remove_segments();
+        execv( "/proc/self/exe", args );
+        _exit( 127 );
+    }
+
+    sleep_seconds( seconds );
+    kill( -pid, SIGINT );
+    result->elapsed_s = ( get_timestamp_ns() - started ) / 1e9;
+
+    // - The interrupted parent exits first, its orphans get reaped here
+    uint64_t deadline = get_timestamp_ns() + SWEEP_GRACE_SECS * 1000000000ull;
+
+    for ( ;; )
+    {
+        pid_t reaped = waitpid( -1, &status, WNOHANG );
+
+        if ( reaped == -1 && errno == ECHILD ) break;
+        if ( reaped > 0 ) continue;
+
+        if ( get_timestamp_ns() > deadline ) kill( -pid, SIGKILL );
+        usleep( 10000 );
+    }
+
+    result->cpu_s = children_cpu() - cpu;
+
+    int found = read_summary( summary, result );
+
+    unlink( summary );
+    unlink( counters );
+
+    return found;
+}
+
+/**
+ * Print the header of the output
+ *
+ * @param FILE * out
+ * @param int    json
+ */
+static void print_header( FILE *out, int json )
+{
+    if ( json )
+    {
+        fprintf( out, "[\n" );
+        return;
+    }
+
+    for ( uint i = 0; i < AXIS_COUNT; i++ ) fprintf( out, "%s,", axis[i].name );
+
+    fprintf( out, "run,elapsed_s,emitted,received,expected,throughput_eps,loss_pct,"
+                  "latency_p50_us,latency_p90_us,latency_p99_us,cpu_us_per_event\n" );
+}
+
+/**
+ * Print the row of one run
+ *
+ * @param FILE *                out
+ * @param int                   json
+ * @param int                   first  row of the JSON array
+ * @param const char **         cell
+ * @param uint                  run
+ * @param struct sweep_result * result
+ */
+static void print_row( FILE *out, int json, int first, const char **cell, uint run, struct sweep_result *result )
+{
+    double throughput = result->received / result->elapsed_s;
+    double loss = result->expected ? 100.0 * ( (double)result->expected - result->received ) / result->expected : 0.0;
+    double cpu  = result->received ? result->cpu_s * 1e6 / result->received : 0.0;
+
+    if ( loss < 0 ) loss = 0;
+
+    if ( json )
+    {
+        fprintf( out, "%s  {", first ? "" : ",\n" );
+        for ( uint i = 0; i < AXIS_COUNT; i++ )
+        {
+            // - The numeric axes stay numbers
+            if ( i == AXIS_TRANSPORT || i == AXIS_COUNTERS || i == AXIS_LOCK ) fprintf( out, "\"%s\": \"%s\", ", axis[i].name, cell[i] );
+            else fprintf( out, "\"%s\": %s, ", axis[i].name, cell[i] );
+        }
+        fprintf( out, "\"run\": %u, \"elapsed_s\": %.3f, \"emitted\": %llu, \"received\": %llu, \"expected\": %llu, "
+                      "\"throughput_eps\": %.1f, \"loss_pct\": %.3f, \"latency_p50_us\": %.1f, \"latency_p90_us\": %.1f, "
+                      "\"latency_p99_us\": %.1f, \"cpu_us_per_event\": %.2f}",
+                 run, result->elapsed_s, (unsigned long long)result->emitted, (unsigned long long)result->received,
+                 (unsigned long long)result->expected, throughput, loss, result->latency_p50_ns / 1e3,
+                 result->latency_p90_ns / 1e3, result->latency_p99_ns / 1e3, cpu );
+    }
+    else
+    {
+        for ( uint i = 0; i < AXIS_COUNT; i++ ) fprintf( out, "%s,", cell[i] );
+
+        fprintf( out, "%u,%.3f,%llu,%llu,%llu,%.1f,%.3f,%.1f,%.1f,%.1f,%.2f\n",
+                 run, result->elapsed_s, (unsigned long long)result->emitted, (unsigned long long)result->received,
+                 (unsigned long long)result->expected, throughput, loss, result->latency_p50_ns / 1e3,
+                 result->latency_p90_ns / 1e3, result->latency_p99_ns / 1e3, cpu );
+    }
+
+    fflush( out );
+}
+
+/**
+ * The 'sweep' sub program
+ *
+ * @param  int     argc
+ * @param  char ** argv  argv[1] is "sweep"
+ * @return int     exit status
+ */
+int sweep( int argc, char *argv[] )
+{
+    char       *forwarded[ 64 ];
+    uint        forwarded_count = 0;
+    uint        repeat = 1;
+    double      seconds = SWEEP_DEFAULT_SECS;
+    int         json = 0;
+    FILE       *out = stdout;
+
+    for ( int i = 2; i < argc; i++ )
+    {
+        char *value = strchr( argv[i], '=' );
+        int   known = 0;
+
+        if ( strncmp( argv[i], "--", 2 ) == 0 )
+        {
+            if ( forwarded_count < 63 ) forwarded[ forwarded_count++ ] = argv[i];
+            continue;
+        }
+
+        if ( value == NULL )
+        {
+            fprintf( stderr, "Expected name=value, got %s\n", argv[i] );
+            return EXIT_FAILURE;
+        }
+        *value++ = '\0';
+
+        for ( uint a = 0; a < AXIS_COUNT; a++ )
+        {
+            if ( strcmp( argv[i], axis[a].name ) != 0 ) continue;
+
+            if ( !parse_axis( &axis[a], value ) )
+            {
+                fprintf( stderr, "Axis %s needs 1...%i values\n", axis[a].name, SWEEP_MAX_VALUES );
+                return EXIT_FAILURE;
+            }
+            known = 1;
+        }
+
+        if ( known ) continue;
+
+        if ( strcmp( argv[i], "repeat" ) == 0 ) repeat = strtoul( value, NULL, 10 );
+        else if ( strcmp( argv[i], "duration" ) == 0 ) seconds = strtod( value, NULL );
+        else if ( strcmp( argv[i], "format" ) == 0 ) json = strcmp( value, "json" ) == 0;
+        else if ( strcmp( argv[i], "output" ) == 0 )
+        {
+            if ( ( out = fopen( value, "w" ) ) == NULL ) fail( "fopen()" );
+        }
+        else
+        {
+            fprintf( stderr, "Unknown sweep parameter %s\n", argv[i] );
+            return EXIT_FAILURE;
+        }
+    }
+    forwarded[ forwarded_count ] = NULL;
+
+    if ( repeat < 1 ) repeat = 1;
+    if ( seconds <= 0 ) seconds = SWEEP_DEFAULT_SECS;
+
+    // - Orphans of the interrupted runs get reparented to the driver
+    if ( prctl( PR_SET_CHILD_SUBREAPER, 1 ) == -1 ) perror( "prctl()" );
+    signal( SIGINT, SIG_DFL );
+
+    uint cells = 1;
+    for ( uint a = 0; a < AXIS_COUNT; a++ ) cells *= axis[a].count;
+
+    fprintf( stderr, "Sweeping %u cells x %u runs of %.1fs\n", cells, repeat, seconds );
+    print_header( out, json );
+
+    uint rows = 0, failed = 0;
+
+    for ( uint index = 0; index < cells; index++ )
+    {
+        const char *cell[ AXIS_COUNT ];
+        uint        rest = index;
+
+        // - Mixed radix digits of the cell index, the last axis varies fastest
+        for ( int a = AXIS_COUNT - 1; a >= 0; a-- )
+        {
+            cell[a] = axis[a].value[ rest % axis[a].count ];
+            rest /= axis[a].count;
+        }
+
+        for ( uint run = 1; run <= repeat; run++ )
+        {
+            struct sweep_result result;
+            memset( &result, 0, sizeof( result ) );
+
+            fprintf( stderr, "\tcell %u/%u run %u: generators %s, handlers %s, sources %s, transport %s, counters %s, lock %s\n",
+                     index + 1, cells, run, cell[ AXIS_GENERATORS ], cell[ AXIS_HANDLERS ], cell[ AXIS_SOURCES ],
+                     cell[ AXIS_TRANSPORT ], cell[ AXIS_COUNTERS ], cell[ AXIS_LOCK ] );
+
+            if ( !run_cell( cell, forwarded, seconds, &result ) )
+            {
+                fprintf( stderr, "\t\trun left no summary, skipped\n" );
+                failed++;
+                continue;
+            }
+
+            print_row( out, json, rows++ == 0, cell, run, &result );
+        }
+    }
+
+    if ( json ) fprintf( out, "\n]\n" );
+    if ( out != stdout ) fclose( out );
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#ifndef _SWEEP_H_
+#define _SWEEP_H_
+
+/* Description:
+ * Parameter sweep driver.
+ * "./app sweep axis=v1,v2,... setting=value ..." runs every cell of the
+ * matrix of the axes 'repeat' times. Every run is a fresh process tree: the
+ * driver forks, the child starts a new session and executes this binary with
+ * the options of the cell and a --summary file, after 'duration' seconds the
+ * driver interrupts the session like CTRL-C would. The driver is a child
+ * subreaper, so it also reaps the roles orphaned by the interrupted parent
+ * and their CPU time lands in its RUSAGE_CHILDREN.
+ * One row per run goes to stdout (or 'output') as CSV or JSON:
+ *  - throughput: received events per second
+ *  - loss: share of the expected receptions missing, a broadcast event is
+ *    expected once per handler of its group
+ *  - latency: p50 / p90 / p99 upper bounds of the log2 latency histogram
+ *  - cpu: user + system time of the whole tree per received event
+ * Axes:     generators, handlers, sources (the emission rate knob, 0 keeps
+ *           the 10...100 ms sleeps), transport, counters ("shm" or "file"),
+ *           lock (of the counter updates: "mutex", "ticket" or "atomic")
+ * Settings: repeat, duration (seconds), format ("csv" or "json"), output
+ * Other "--option" arguments are passed to every run.
+ */
+
+#define SWEEP_MAX_VALUES   16
+#define SWEEP_DEFAULT_SECS 5
+#define SWEEP_GRACE_SECS   5          /* after the interrupt, then SIGKILL */
+#define SWEEP_SUMMARY      "/tmp/project3-sweep-%i.summary"
+#define SWEEP_COUNTERS     "/tmp/project3-sweep-%i.counters"
+
+enum sweep_axis_id
+{
+    AXIS_GENERATORS,
+    AXIS_HANDLERS,
+    AXIS_SOURCES,
+    AXIS_TRANSPORT,
+    AXIS_COUNTERS,
+    AXIS_LOCK,
+    AXIS_COUNT
+};
+
+struct sweep_axis
+{
+    const char *name;
+    const char *value[ SWEEP_MAX_VALUES ];
+    uint        count;
+};
+
+struct sweep_result
+{
+    double   elapsed_s;
+    uint64_t emitted;
+    uint64_t received;
+    uint64_t expected;
+    uint64_t latency_p50_ns;
+    uint64_t latency_p90_ns;
+    uint64_t latency_p99_ns;
+    double   cpu_s;
+};
+
+int sweep( int argc, char *argv[] );
+
+#endif /* _SWEEP_H_ */
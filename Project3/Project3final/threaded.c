@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+#include "header.h"
+#include "options.h"
+#include "threaded.h"
+
+static pthread_t handler_thread[ MAX_RX_PROCESSES ];
+static int       handler_running[ MAX_RX_PROCESSES ];
+
+struct handler_arguments
+{
+    int group;
+    int slot;
+};
+
+static void *report_thread( __attribute__(( unused )) void *argument )
+{
+    report_loop();
+
+    return NULL;
+}
+
+static void *handler_main( void *argument )
+{
+    struct handler_arguments *handler = argument;
+
+    signal_handler_loop( handler->group, handler->slot );
+
+    return NULL;
+}
+
+static void *generator_thread( void *id )
+{
+    signal_generator_loop( (int)(intptr_t)id );
+
+    return NULL;
+}
+
+/**
+ * Send 'signum' to every handler thread of its group, queued with 'value'
+ * naming the generator (and the sequence number when tracking sequences)
+ *
+ * @param int signum
+ * @param int value
+ */
+void thread_signal( int signum, int value )
+{
+    union sigval sigval;
+    sigval.sival_int = value;
+
+    for ( uint slot = 0; slot < options.handlers; slot++ )
+    {
+        if ( !handler_running[ slot ] || handler_group[ slot ] != ( signum == SIGUSR1 ) ) continue;
+
+        pthread_sigqueue( handler_thread[ slot ], signum, sigval );
+    }
+}
+
+/**
+ * Run the reporter, the handlers and the generators as threads,
+ * returns once the generators are done and the others stopped
+ *
+ * @return int
+ */
+int run_threads()
+{
+    static struct handler_arguments handler[ MAX_RX_PROCESSES ];
+    pthread_t reporter, generator[ MAX_TX_PROCESSES ];
+
+    printf( "MAIN: Threaded mode, creating the reporting thread\n\n" );
+    fflush( stdout );
+
+    if ( pthread_create( &reporter, NULL, report_thread, NULL ) != 0 ) fail( "pthread_create()" );
+
+    for ( uint slot = 0; slot < options.handlers; slot++ )
+    {
+        handler[ slot ].group = ( options.handlers - 1 - slot ) & 1;
+        handler[ slot ].slot  = slot;
+        handler_group[ slot ] = handler[ slot ].group;
+
+        printf( "Creating signal handler thread %i type %i\n", slot + 1, handler[ slot ].group );
+        if ( pthread_create( &handler_thread[ slot ], NULL, handler_main, &handler[ slot ] ) != 0 ) fail( "pthread_create()" );
+        handler_running[ slot ] = 1;
+    }
+
+    for ( uint id = 0; id < options.generators; id++ )
+    {
+        printf( "Creating signal generator thread %i\n", id + 1 );
+        if ( pthread_create( &generator[ id ], NULL, generator_thread, (void *)(intptr_t)id ) != 0 ) fail( "pthread_create()" );
+    }
+
+    for ( uint id = 0; id < options.generators; id++ ) pthread_join( generator[ id ], NULL );
+
+    // - Stop the loops, the handlers get woken up until they all returned
+    __atomic_store_n( &child_loop, 0, __ATOMIC_RELEASE );
+
+    for ( uint slot = 0; slot < options.handlers; slot++ )
+    {
+        while ( pthread_tryjoin_np( handler_thread[ slot ], NULL ) != 0 )
+        {
+            pthread_kill( handler_thread[ slot ], handler[ slot ].group ? SIGUSR1 : SIGUSR2 );
+            usleep( 1000 );
+        }
+        handler_running[ slot ] = 0;
+    }
+
+    pthread_join( reporter, NULL );
+    printf( "MAIN: All threads completed\n\n" );
+
+    return 1;
+}
@@ -0,0 +1,19 @@
+#ifndef _THREADED_H_
+#define _THREADED_H_
+
+/* Description:
+ * Threaded execution mode.
+ * The reporter, the handlers and the generators run their usual loops as
+ * threads of one process instead of forked children. Every thread keeps
+ * SIGUSR1 and SIGUSR2 blocked, the generators address the handler threads
+ * of a group with pthread_sigqueue() carrying the generator id and sequence
+ * value, since a kill() to the process would wake any one of them and the
+ * threads share the si_pid the handlers attribute the events by.
+ * The counters become plain atomics of the process.
+ */
+#include <pthread.h>
+
+void thread_signal( int signum, int value );
+int  run_threads();
+
+#endif /* _THREADED_H_ */
@@ -0,0 +1,576 @@
+#define _GNU_SOURCE     /* for sendmmsg() / recvmmsg() */
+#include "header.h"
+#include "uring.h"
+#include "sock_transport.h"
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+#include <sys/epoll.h>
+
+// - Kernel support, probed once: -1 unknown
+static int supported = -1;
+static int read_multishot = 0;
+
+/**
+ * Probe io_uring and the opcodes this backend needs
+ *
+ * @return int 1 when the backend is usable
+ */
+int uring_supported()
+{
+    struct io_uring_params params;
+    struct
+    {
+        struct io_uring_probe    probe;
+        struct io_uring_probe_op op[ 256 ];
+    } probe;
+
+    if ( supported != -1 ) return supported;
+
+    supported = 0;
+    memset( &params, 0, sizeof( params ) );
+
+    int fd = syscall( __NR_io_uring_setup, 2, &params );
+    if ( fd == -1 ) return 0;
+
+    memset( &probe, 0, sizeof( probe ) );
+
+    if ( syscall( __NR_io_uring_register, fd, IORING_REGISTER_PROBE, &probe, 256 ) == 0 )
+    {
+        uint8_t needed[] = { IORING_OP_PROVIDE_BUFFERS, IORING_OP_RECV, IORING_OP_READ, IORING_OP_SENDMSG };
+
+        supported = 1;
+        for ( uint i = 0; i < sizeof( needed ); i++ )
+        {
+            if ( needed[i] > probe.probe.last_op || !( probe.op[ needed[i] ].flags & IO_URING_OP_SUPPORTED ) ) supported = 0;
+        }
+
+        read_multishot = IORING_OP_READ_MULTISHOT <= probe.probe.last_op &&
+                         ( probe.op[ IORING_OP_READ_MULTISHOT ].flags & IO_URING_OP_SUPPORTED );
+    }
+
+    close( fd );
+
+    return supported;
+}
+
+/**
+ * Create a ring of 'entries' submission slots and map its queues
+ *
+ * @param  struct uring * ring
+ * @param  uint           entries
+ * @return int 1 on success
+ */
+int uring_init( struct uring *ring, uint entries )
+{
+    struct io_uring_params params;
+
+    memset( ring, 0, sizeof( *ring ) );
+    memset( &params, 0, sizeof( params ) );
+    ring->fd = -1;
+    ring->source_fd = -1;
+
+    if ( !uring_supported() ) return 0;
+
+    int fd = syscall( __NR_io_uring_setup, entries, &params );
+    if ( fd == -1 ) return 0;
+
+    ring->fd           = fd;
+    ring->features     = params.features;
+    ring->sq_entries   = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof( uint32_t );
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+    ring->sqe_size     = params.sq_entries * sizeof( struct io_uring_sqe );
+
+    // - Both queues share one mapping on linux 5.4+
+    if ( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        if ( ring->cq_ring_size > ring->sq_ring_size ) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap( NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    if ( ring->sq_ring == MAP_FAILED ) ring->sq_ring = NULL;
+
+    if ( params.features & IORING_FEAT_SINGLE_MMAP ) ring->cq_ring = ring->sq_ring;
+    else
+    {
+        ring->cq_ring = mmap( NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+        if ( ring->cq_ring == MAP_FAILED ) ring->cq_ring = NULL;
+    }
+
+    ring->sqe = mmap( NULL, ring->sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if ( ring->sqe == MAP_FAILED ) ring->sqe = NULL;
+
+    if ( !ring->sq_ring || !ring->cq_ring || !ring->sqe )
+    {
+        uring_close( ring );
+        return 0;
+    }
+
+    char *sq = ring->sq_ring, *cq = ring->cq_ring;
+
+    ring->sq_head  = (uint32_t *)( sq + params.sq_off.head );
+    ring->sq_tail  = (uint32_t *)( sq + params.sq_off.tail );
+    ring->sq_mask  = (uint32_t *)( sq + params.sq_off.ring_mask );
+    ring->sq_array = (uint32_t *)( sq + params.sq_off.array );
+    ring->cq_head  = (uint32_t *)( cq + params.cq_off.head );
+    ring->cq_tail  = (uint32_t *)( cq + params.cq_off.tail );
+    ring->cq_mask  = (uint32_t *)( cq + params.cq_off.ring_mask );
+    ring->cqe      = (struct io_uring_cqe *)( cq + params.cq_off.cqes );
+
+    // - Submission slot i always holds sqe i
+    for ( uint i = 0; i < params.sq_entries; i++ ) ring->sq_array[i] = i;
+
+    return 1;
+}
+
+/**
+ * Unmap the queues and close the ring, the armed request goes with it
+ *
+ * @param struct uring * ring
+ */
+void uring_close( struct uring *ring )
+{
+    if ( ring->sqe ) munmap( ring->sqe, ring->sqe_size );
+    if ( ring->cq_ring && ring->cq_ring != ring->sq_ring ) munmap( ring->cq_ring, ring->cq_ring_size );
+    if ( ring->sq_ring ) munmap( ring->sq_ring, ring->sq_ring_size );
+    if ( ring->fd != -1 ) close( ring->fd );
+
+    free( ring->buffer );
+    memset( ring, 0, sizeof( *ring ) );
+    ring->fd = -1;
+    ring->source_fd = -1;
+}
+
+/**
+ * Submit the queued requests and wait for 'wait' completions
+ *
+ * @param  struct uring * ring
+ * @param  uint           wait
+ * @return int            io_uring_enter() result
+ */
+static int enter( struct uring *ring, uint wait )
+{
+    uint32_t tail = *ring->sq_tail + ring->sq_queued;
+
+    __atomic_store_n( ring->sq_tail, tail, __ATOMIC_RELEASE );
+    ring->sq_queued = 0;
+    ring->enters++;
+
+    // - Also resubmits requests left over by an interrupted call
+    uint32_t submit = tail - __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+
+    return syscall( __NR_io_uring_enter, ring->fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+}
+
+/**
+ * Returns a cleared submission entry, submitting first when the queue is full
+ *
+ * @param  struct uring * ring
+ * @return struct io_uring_sqe *
+ */
+static struct io_uring_sqe *next_sqe( struct uring *ring )
+{
+    uint32_t tail = *ring->sq_tail + ring->sq_queued;
+
+    if ( tail - __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE ) >= ring->sq_entries ) enter( ring, 0 );
+
+    tail = *ring->sq_tail + ring->sq_queued++;
+
+    struct io_uring_sqe *sqe = &ring->sqe[ tail & *ring->sq_mask ];
+    memset( sqe, 0, sizeof( *sqe ) );
+
+    return sqe;
+}
+
+/**
+ * Queue the hand over of 'count' buffers starting at 'id' to the kernel
+ *
+ * @param struct uring * ring
+ * @param uint           id
+ * @param uint           count
+ */
+static void provide_buffers( struct uring *ring, uint id, uint count )
+{
+    struct io_uring_sqe *sqe = next_sqe( ring );
+
+    sqe->opcode    = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd        = count;
+    sqe->addr      = (uint64_t)(uintptr_t)( ring->buffer + id * ring->buffer_size );
+    sqe->len       = ring->buffer_size;
+    sqe->off       = id;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = URING_PROVIDE;
+
+    if ( ring->features & IORING_FEAT_CQE_SKIP ) sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+}
+
+/**
+ * Queue the receive request on the source, multishot when the kernel has it
+ *
+ * @param struct uring * ring
+ */
+static void arm( struct uring *ring )
+{
+    struct io_uring_sqe *sqe = next_sqe( ring );
+
+    sqe->fd        = ring->source_fd;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = URING_ARM;
+
+    if ( ring->is_socket )
+    {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = ring->multishot ? IORING_RECV_MULTISHOT : 0;
+        sqe->len    = ring->multishot ? 0 : ring->buffer_size;
+    }
+    else
+    {
+        sqe->opcode = ring->multishot ? IORING_OP_READ_MULTISHOT : IORING_OP_READ;
+        sqe->len    = ring->multishot ? 0 : ring->buffer_size;
+        sqe->off    = (uint64_t)-1;
+    }
+
+    ring->armed = 1;
+}
+
+/**
+ * Receive records of 'size' bytes from 'fd', a datagram socket
+ * or a signalfd, through URING_BUFFERS provided buffers
+ *
+ * @param  struct uring * ring
+ * @param  int            fd
+ * @param  uint           size
+ * @param  int            is_socket
+ * @return int 1 on success
+ */
+int uring_arm_receive( struct uring *ring, int fd, uint size, int is_socket )
+{
+    ring->buffer = malloc( (size_t)size * URING_BUFFERS );
+    if ( ring->buffer == NULL ) return 0;
+
+    ring->source_fd   = fd;
+    ring->buffer_size = size;
+    ring->is_socket   = is_socket;
+    ring->multishot   = is_socket || read_multishot;
+
+    provide_buffers( ring, 0, URING_BUFFERS );
+    arm( ring );
+
+    return enter( ring, 0 ) >= 0;
+}
+
+/**
+ * Copy up to 'max' received records to 'records', blocking until at
+ * least one is there. The kernel is only entered when the completion
+ * queue is empty
+ *
+ * @param  struct uring * ring
+ * @param  void *         records  room for 'max' records of the buffer size
+ * @param  uint           max
+ * @return int            records received, -1 on error
+ */
+int uring_receive( struct uring *ring, void *records, uint max )
+{
+    uint count = 0;
+
+    while ( count == 0 )
+    {
+        if ( !ring->armed ) arm( ring );
+
+        uint32_t head = *ring->cq_head;
+
+        if ( head == __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE ) )
+        {
+            if ( enter( ring, 1 ) == -1 ) return -1;
+            continue;
+        }
+
+        for ( ; count < max && head != __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE ); head++ )
+        {
+            struct io_uring_cqe *cqe = &ring->cqe[ head & *ring->cq_mask ];
+
+            if ( cqe->user_data != URING_ARM ) continue;
+
+            if ( !( cqe->flags & IORING_CQE_F_MORE ) ) ring->armed = 0;
+
+            if ( cqe->flags & IORING_CQE_F_BUFFER )
+            {
+                uint id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+                if ( cqe->res > 0 ) memcpy( (char *)records + count++ * ring->buffer_size, ring->buffer + id * ring->buffer_size, ring->buffer_size );
+                provide_buffers( ring, id, 1 );
+                continue;
+            }
+
+            // - Kernels before 6.0 reject the multishot recv, re-arm one shot requests
+            if ( cqe->res == -EINVAL && ring->multishot ) ring->multishot = 0;
+            else if ( cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -EINTR && cqe->res != -EAGAIN )
+            {
+                __atomic_store_n( ring->cq_head, head + 1, __ATOMIC_RELEASE );
+                errno = -cqe->res;
+                return count ? (int)count : -1;
+            }
+        }
+
+        __atomic_store_n( ring->cq_head, head, __ATOMIC_RELEASE );
+    }
+
+    return count;
+}
+
+/**
+ * sigwaitinfo() on a signalfd armed with uring_arm_receive()
+ *
+ * @param  struct uring * ring
+ * @param  siginfo_t *    info
+ * @return int            signal number, -1 on error
+ */
+int uring_sigwaitinfo( struct uring *ring, siginfo_t *info )
+{
+    struct signalfd_siginfo signal;
+
+    if ( uring_receive( ring, &signal, 1 ) != 1 ) return -1;
+
+    memset( info, 0, sizeof( *info ) );
+    info->si_signo = signal.ssi_signo;
+    info->si_code  = signal.ssi_code;
+    info->si_pid   = signal.ssi_pid;
+    info->si_value.sival_int = signal.ssi_int;
+
+    return signal.ssi_signo;
+}
+
+/**
+ * Send 'count' prepared messages on 'fd', one linked SENDMSG request
+ * each so they leave in order, submitted together
+ *
+ * @param  struct uring *   ring
+ * @param  int              fd
+ * @param  struct mmsghdr * message
+ * @param  uint             count
+ * @return int              messages sent
+ */
+int uring_send_batch( struct uring *ring, int fd, struct mmsghdr *message, uint count )
+{
+    uint sent = 0;
+
+    for ( uint first = 0; first < count; )
+    {
+        uint chunk = count - first;
+        if ( chunk > ring->sq_entries ) chunk = ring->sq_entries;
+
+        for ( uint i = 0; i < chunk; i++ )
+        {
+            struct io_uring_sqe *sqe = next_sqe( ring );
+
+            sqe->opcode    = IORING_OP_SENDMSG;
+            sqe->fd        = fd;
+            sqe->addr      = (uint64_t)(uintptr_t)&message[ first + i ].msg_hdr;
+            sqe->len       = 1;
+            sqe->flags     = i + 1 < chunk ? IOSQE_IO_LINK : 0;
+            sqe->user_data = first + i;
+        }
+
+        uint reaped = 0;
+
+        for ( uint wait = chunk; reaped < chunk; wait = chunk - reaped )
+        {
+            if ( enter( ring, wait ) == -1 && errno != EINTR ) return sent;
+
+            uint32_t head = *ring->cq_head;
+
+            for ( ; head != __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE ); head++, reaped++ )
+            {
+                struct io_uring_cqe *cqe = &ring->cqe[ head & *ring->cq_mask ];
+
+                if ( cqe->res >= 0 ) sent++;
+                else errno = -cqe->res;
+            }
+
+            __atomic_store_n( ring->cq_head, head, __ATOMIC_RELEASE );
+        }
+
+        first += chunk;
+    }
+
+    return sent;
+}
+
+// --------------------------------------------------------------------------------
+// -
+// - Benchmark: receive side cost per event of the io_uring backend against
+// - epoll_wait() + recvmmsg() on a socket and sigwaitinfo() on queued signals
+// -
+
+#define BENCH_ROUNDS 20000
+#define BENCH_BATCH  32
+
+/**
+ * Print one benchmark row
+ *
+ * @param const char * path
+ * @param uint64_t     events
+ * @param uint64_t     elapsed_ns
+ * @param uint64_t     syscalls
+ */
+static void print_row( const char *path, uint64_t events, uint64_t elapsed_ns, uint64_t syscalls )
+{
+    printf( "%-28s %10llu %14.1f %16.3f\n", path, (unsigned long long)events,
+            (double)elapsed_ns / events, (double)syscalls / events );
+}
+
+/**
+ * Queue BENCH_BATCH datagrams from 'fd' to its peer with one sendmmsg()
+ *
+ * @param int fd
+ */
+static void bench_send( int fd )
+{
+    static struct event   event[ BENCH_BATCH ];
+    static struct mmsghdr message[ BENCH_BATCH ];
+    static struct iovec   vector[ BENCH_BATCH ];
+
+    for ( uint i = 0; i < BENCH_BATCH; i++ )
+    {
+        event[i].seq = i;
+        vector[i].iov_base = &event[i];
+        vector[i].iov_len  = sizeof( struct event );
+        message[i].msg_hdr.msg_iov    = &vector[i];
+        message[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    sendmmsg( fd, message, BENCH_BATCH, 0 );
+}
+
+/**
+ * The 'uring-bench' sub program
+ *
+ * @return int exit status
+ */
+int uring_benchmark()
+{
+    struct event   events[ SOCK_MAX_BATCH ];
+    struct mmsghdr message[ BENCH_BATCH ];
+    struct iovec   vector[ BENCH_BATCH ];
+    struct uring   ring;
+    uint64_t       elapsed, syscalls, received;
+    int            pair[2];
+
+    if ( !uring_supported() )
+    {
+        printf( "io_uring is not available on this kernel\n" );
+        return EXIT_FAILURE;
+    }
+
+    if ( socketpair( AF_UNIX, SOCK_DGRAM, 0, pair ) == -1 ) fail( "socketpair()" );
+
+    printf( "%u rounds of %u events, receive side only\n", BENCH_ROUNDS, BENCH_BATCH );
+    printf( "%-28s %10s %14s %16s\n", "path", "events", "ns/event", "syscalls/event" );
+
+    // - epoll_wait() for readiness, then drain with recvmmsg()
+    int epoll = epoll_create1( 0 );
+    struct epoll_event readable = { .events = EPOLLIN };
+    epoll_ctl( epoll, EPOLL_CTL_ADD, pair[1], &readable );
+
+    memset( message, 0, sizeof( message ) );
+
+    for ( uint i = 0; i < BENCH_BATCH; i++ )
+    {
+        vector[i].iov_len = sizeof( struct event );
+        message[i].msg_hdr.msg_iov    = &vector[i];
+        message[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    elapsed = syscalls = received = 0;
+    for ( uint round = 0; round < BENCH_ROUNDS; round++ )
+    {
+        bench_send( pair[0] );
+
+        uint64_t start = get_timestamp_ns();
+        for ( uint count = 0; count < BENCH_BATCH; )
+        {
+            struct epoll_event ready;
+
+            epoll_wait( epoll, &ready, 1, -1 );
+            for ( uint i = 0; i < BENCH_BATCH; i++ ) vector[i].iov_base = &events[i];
+            int result = recvmmsg( pair[1], message, BENCH_BATCH, MSG_DONTWAIT, NULL );
+            syscalls += 2;
+            if ( result > 0 ) count += result;
+        }
+        elapsed += get_timestamp_ns() - start;
+        received += BENCH_BATCH;
+    }
+    print_row( "socket epoll + recvmmsg", received, elapsed, syscalls );
+    close( epoll );
+
+    // - Multishot recv into provided buffers
+    if ( !uring_init( &ring, URING_ENTRIES ) || !uring_arm_receive( &ring, pair[1], sizeof( struct event ), 1 ) ) fail( "uring_init()" );
+
+    elapsed = received = 0;
+    ring.enters = 0;
+    for ( uint round = 0; round < BENCH_ROUNDS; round++ )
+    {
+        bench_send( pair[0] );
+
+        uint64_t start = get_timestamp_ns();
+        for ( uint count = 0; count < BENCH_BATCH; )
+        {
+            int result = uring_receive( &ring, events, SOCK_MAX_BATCH );
+            if ( result > 0 ) count += result;
+        }
+        elapsed += get_timestamp_ns() - start;
+        received += BENCH_BATCH;
+    }
+    print_row( ring.multishot ? "socket io_uring multishot" : "socket io_uring recv", received, elapsed, ring.enters );
+    uring_close( &ring );
+
+    // - Queued real time signals drained one by one with sigwaitinfo()
+    sigset_t  mask;
+    siginfo_t info;
+    union sigval value = { .sival_int = 0 };
+
+    sigemptyset( &mask );
+    sigaddset( &mask, SIGRTMIN );
+    sigprocmask( SIG_BLOCK, &mask, NULL );
+
+    elapsed = syscalls = received = 0;
+    for ( uint round = 0; round < BENCH_ROUNDS; round++ )
+    {
+        for ( uint i = 0; i < BENCH_BATCH; i++ ) sigqueue( getpid(), SIGRTMIN, value );
+
+        uint64_t start = get_timestamp_ns();
+        for ( uint i = 0; i < BENCH_BATCH; i++ ) sigwaitinfo( &mask, &info );
+        elapsed += get_timestamp_ns() - start;
+        syscalls += BENCH_BATCH;
+        received += BENCH_BATCH;
+    }
+    print_row( "signal sigwaitinfo", received, elapsed, syscalls );
+
+    // - The same signals read from a signalfd through the ring
+    int fd = signalfd( -1, &mask, SFD_CLOEXEC );
+    if ( fd == -1 || !uring_init( &ring, URING_ENTRIES ) || !uring_arm_receive( &ring, fd, sizeof( struct signalfd_siginfo ), 0 ) ) fail( "uring_init()" );
+
+    elapsed = received = 0;
+    ring.enters = 0;
+    for ( uint round = 0; round < BENCH_ROUNDS; round++ )
+    {
+        for ( uint i = 0; i < BENCH_BATCH; i++ ) sigqueue( getpid(), SIGRTMIN, value );
+
+        uint64_t start = get_timestamp_ns();
+        for ( uint i = 0; i < BENCH_BATCH; i++ ) uring_sigwaitinfo( &ring, &info );
+        elapsed += get_timestamp_ns() - start;
+        received += BENCH_BATCH;
+    }
+    print_row( ring.multishot ? "signal io_uring multishot" : "signal io_uring read", received, elapsed, ring.enters );
+    uring_close( &ring );
+    close( fd );
+
+    sigprocmask( SIG_UNBLOCK, &mask, NULL );
+    close( pair[0] );
+    close( pair[1] );
+
+    return EXIT_SUCCESS;
+}
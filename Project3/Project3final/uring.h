@@ -0,0 +1,76 @@
+#ifndef _URING_H_
+#define _URING_H_
+
+/* Description:
+ * Minimal io_uring backend on the raw io_uring_setup() / io_uring_enter()
+ * system calls, there is no liburing dependency.
+ * Receivers keep one multishot request armed on their socket (multishot
+ * recv) or signalfd (multishot read, plain read re-armed per completion on
+ * kernels without it). Completions land in a group of provided buffers,
+ * consumed buffers are handed back with PROVIDE_BUFFERS requests that ride
+ * along the next io_uring_enter(), which is only issued once the completion
+ * queue is empty. A burst of events then costs one system call instead of
+ * one per wakeup.
+ * Generators queue one SENDMSG request per datagram and submit the whole
+ * batch with one io_uring_enter().
+ * uring_supported() probes the kernel once, callers fall back to the
+ * recvmmsg() / sendmmsg() / sigwaitinfo() paths when it returns 0.
+ */
+#include <stdint.h>
+#include <signal.h>
+#include <linux/io_uring.h>
+
+struct mmsghdr;
+
+#ifndef IORING_OP_READ_MULTISHOT
+#define IORING_OP_READ_MULTISHOT 49   /* linux 6.7 */
+#endif
+
+#define URING_ENTRIES       256       /* power of two */
+#define URING_BUFFER_GROUP  1
+#define URING_BUFFERS       64
+#define URING_ARM           ( (uint64_t)-1 )
+#define URING_PROVIDE       ( (uint64_t)-2 )
+
+struct uring
+{
+    int                  fd;
+    uint32_t            *sq_head;
+    uint32_t            *sq_tail;
+    uint32_t            *sq_mask;
+    uint32_t            *sq_array;
+    uint32_t             sq_entries;
+    uint32_t             sq_queued;   /* not yet submitted */
+    struct io_uring_sqe *sqe;
+    uint32_t            *cq_head;
+    uint32_t            *cq_tail;
+    uint32_t            *cq_mask;
+    struct io_uring_cqe *cqe;
+    void                *sq_ring;
+    size_t               sq_ring_size;
+    void                *cq_ring;
+    size_t               cq_ring_size;
+    size_t               sqe_size;
+    uint32_t             features;
+
+    // - Receiving side
+    int                  source_fd;
+    int                  is_socket;   /* recv, else read */
+    int                  multishot;
+    int                  armed;
+    uint                 buffer_size;
+    char                *buffer;
+
+    uint64_t             enters;      /* io_uring_enter() calls */
+};
+
+int  uring_supported();
+int  uring_init( struct uring *ring, uint entries );
+void uring_close( struct uring *ring );
+int  uring_arm_receive( struct uring *ring, int fd, uint size, int is_socket );
+int  uring_receive( struct uring *ring, void *records, uint max );
+int  uring_sigwaitinfo( struct uring *ring, siginfo_t *info );
+int  uring_send_batch( struct uring *ring, int fd, struct mmsghdr *message, uint count );
+int  uring_benchmark();
+
+#endif /* _URING_H_ */
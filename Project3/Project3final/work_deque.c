@@ -0,0 +1,325 @@
+#include "header.h"
+#include "segment.h"
+#include "spinlock.h"
+#include "work_deque.h"
+
+struct work_deques *work_deques = NULL;
+
+/**
+ * Create the shared memory deques
+ *
+ * @return int
+ */
+int work_deque_init()
+{
+    work_deques = segment_create( WORK_DEQUE_FILE, sizeof( struct work_deques ) );
+
+    return work_deques != NULL;
+}
+
+/**
+ * Remove the deque file from the os
+ */
+void work_deque_remove()
+{
+    segment_remove( WORK_DEQUE_FILE );
+}
+
+/**
+ * Returns the amount of queued items of a deque, without locking
+ *
+ * @param  struct work_deque * deque
+ * @return uint32_t
+ */
+static uint32_t deque_size( struct work_deque *deque )
+{
+    return __atomic_load_n( &deque->tail, __ATOMIC_ACQUIRE ) - __atomic_load_n( &deque->head, __ATOMIC_ACQUIRE );
+}
+
+/**
+ * Announce the handler in 'slot' serving the signal 'group'
+ *
+ * @param int slot
+ * @param int group
+ */
+void work_deque_register( int slot, int group )
+{
+    struct work_stats *stats = &work_deques->deque[ slot ].stats;
+
+    // - A reused slot starts with fresh statistics
+    memset( stats, 0, sizeof( *stats ) );
+
+    stats->group    = group;
+    stats->start_ns = get_timestamp_ns();
+    __atomic_store_n( &stats->pid, getpid(), __ATOMIC_RELEASE );
+}
+
+/**
+ * Stop receiving pushes, queued leftovers get stolen by the other handlers
+ *
+ * @param int slot
+ */
+void work_deque_unregister( int slot )
+{
+    __atomic_store_n( &work_deques->deque[ slot ].stats.pid, 0, __ATOMIC_RELEASE );
+}
+
+/**
+ * Ask the handler in 'slot' to leave its loop
+ *
+ * @param int slot
+ */
+void work_deque_retire( int slot )
+{
+    __atomic_store_n( &work_deques->deque[ slot ].stats.retire, 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Returns non zero when the handler in 'slot' has been asked to retire
+ *
+ * @param  int slot
+ * @return int
+ */
+int work_deque_retiring( int slot )
+{
+    return __atomic_load_n( &work_deques->deque[ slot ].stats.retire, __ATOMIC_ACQUIRE );
+}
+
+/**
+ * Returns the amount of queued items over all the deques
+ *
+ * @return uint
+ */
+uint work_deque_backlog()
+{
+    uint backlog = 0;
+
+    for ( uint i = 0; i < MAX_RX_PROCESSES; i++ ) backlog += deque_size( &work_deques->deque[i] );
+
+    return backlog;
+}
+
+/**
+ * Returns the amount of queued items of the events of 'group'
+ *
+ * @param  int  group
+ * @return uint
+ */
+uint work_deque_group_backlog( int group )
+{
+    uint backlog = 0;
+
+    for ( uint i = 0; i < MAX_RX_PROCESSES; i++ )
+    {
+        struct work_deque *deque = &work_deques->deque[i];
+
+        for ( uint32_t n = deque->head; n != deque->tail; n++ )
+        {
+            if ( ( deque->item[ n % WORK_DEQUE_SIZE ].type == 0 ) == group ) backlog++;
+        }
+    }
+
+    return backlog;
+}
+
+/**
+ * Push an event of 'type' on the deque of the next handler of its group
+ * Returns 0 when the deque was full and the event got dropped
+ *
+ * @param  int      type
+ * @param  uint     source  generator id
+ * @param  uint32_t seq
+ * @return int
+ */
+int work_push( int type, uint source, uint32_t seq )
+{
+    static uint next = 0;
+    int group = type == 0;
+    int slot = -1;
+
+    // - Round robin over the registered handlers of the group,
+    // - any registered handler when the group has none
+    for ( uint pass = 0; pass < 2 && slot == -1; pass++ )
+    {
+        for ( uint i = 0; i < MAX_RX_PROCESSES && slot == -1; i++ )
+        {
+            uint candidate = ( next + i ) % MAX_RX_PROCESSES;
+            struct work_stats *stats = &work_deques->deque[ candidate ].stats;
+
+            if ( __atomic_load_n( &stats->pid, __ATOMIC_ACQUIRE ) && ( pass || stats->group == group ) )
+            {
+                slot = candidate;
+                next = candidate + 1;
+            }
+        }
+    }
+
+    if ( slot == -1 ) return 0;
+
+    struct work_deque *deque = &work_deques->deque[ slot ];
+    int pushed = 0;
+
+    spin_lock( &deque->lock );
+
+    if ( deque->tail - deque->head < WORK_DEQUE_SIZE )
+    {
+        struct work_item *item = &deque->item[ deque->tail % WORK_DEQUE_SIZE ];
+        item->type        = type;
+        item->source      = source;
+        item->seq         = seq;
+        item->enqueued_ns = get_timestamp_ns();
+        __atomic_store_n( &deque->tail, deque->tail + 1, __ATOMIC_RELEASE );
+        pushed = 1;
+    }
+    else
+    {
+        deque->dropped++;
+    }
+
+    spin_unlock( &deque->lock );
+
+    return pushed;
+}
+
+/**
+ * Take the oldest item of 'deque', returns 0 when empty
+ *
+ * @param  struct work_deque * deque
+ * @param  struct work_item *  item
+ * @return int
+ */
+static int deque_take( struct work_deque *deque, struct work_item *item )
+{
+    int taken = 0;
+
+    if ( deque_size( deque ) == 0 ) return 0;
+
+    spin_lock( &deque->lock );
+
+    if ( deque->tail != deque->head )
+    {
+        *item = deque->item[ deque->head % WORK_DEQUE_SIZE ];
+        __atomic_store_n( &deque->head, deque->head + 1, __ATOMIC_RELEASE );
+        taken = 1;
+    }
+
+    spin_unlock( &deque->lock );
+
+    return taken;
+}
+
+/**
+ * Take the next item for the handler in 'slot': its own deque first,
+ * then steal from the fullest other deque. Returns 0 when all are empty
+ *
+ * @param  int                slot
+ * @param  struct work_item * item
+ * @return int
+ */
+int work_take( int slot, struct work_item *item )
+{
+    if ( deque_take( &work_deques->deque[ slot ], item ) ) return 1;
+
+    while ( 1 )
+    {
+        int      victim = -1;
+        uint32_t most = 0;
+
+        for ( int i = 0; i < MAX_RX_PROCESSES; i++ )
+        {
+            uint32_t size = deque_size( &work_deques->deque[i] );
+            if ( i != slot && size > most )
+            {
+                most = size;
+                victim = i;
+            }
+        }
+
+        if ( victim == -1 ) return 0;
+
+        if ( deque_take( &work_deques->deque[ victim ], item ) )
+        {
+            work_deques->deque[ slot ].stats.stolen++;
+            return 1;
+        }
+    }
+}
+
+/**
+ * Account a completed item: busy time and enqueue -> completion latency
+ *
+ * @param int                slot
+ * @param struct work_item * item
+ * @param uint64_t           started_ns  when the handler took the item
+ */
+void work_done( int slot, struct work_item *item, uint64_t started_ns )
+{
+    struct work_stats *stats = &work_deques->deque[ slot ].stats;
+    uint64_t now = get_timestamp_ns();
+    uint64_t latency = now - item->enqueued_ns;
+    uint bucket = 0;
+
+    while ( bucket < LATENCY_BUCKETS - 1 && ( 1ull << ( bucket + 1 ) ) <= latency ) bucket++;
+
+    stats->busy_ns += now - started_ns;
+    stats->processed++;
+    stats->latency[ bucket ]++;
+}
+
+/**
+ * Returns the upper bound in ns of the 'percentile' of a log2 histogram
+ *
+ * @param  uint64_t * histogram
+ * @param  double     percentile  0...100
+ * @return uint64_t
+ */
+static uint64_t histogram_percentile( uint64_t *histogram, double percentile )
+{
+    uint64_t total = 0, seen = 0;
+
+    for ( uint i = 0; i < LATENCY_BUCKETS; i++ ) total += histogram[i];
+    if ( total == 0 ) return 0;
+
+    for ( uint i = 0; i < LATENCY_BUCKETS; i++ )
+    {
+        seen += histogram[i];
+        if ( seen * 100.0 >= total * percentile ) return 2ull << i;
+    }
+
+    return 0;
+}
+
+/**
+ * Display per handler utilization, steals and tail latency
+ */
+void work_deque_print_report()
+{
+    uint64_t all[ LATENCY_BUCKETS ] = { 0 };
+    uint64_t now = get_timestamp_ns();
+
+    if ( work_deques == NULL ) return;
+
+    for ( uint i = 0; i < MAX_RX_PROCESSES; i++ )
+    {
+        struct work_deque *deque = &work_deques->deque[i];
+        struct work_stats *stats = &deque->stats;
+        if ( stats->pid == 0 ) continue;
+
+        uint64_t elapsed = now - stats->start_ns;
+
+        printf( "\tHandler %i group %i: utilization %5.1f%%, processed %llu, stolen %llu, queued %u, dropped %u, p50 %lluus, p99 %lluus\n",
+                stats->pid, stats->group,
+                elapsed ? 100.0 * stats->busy_ns / elapsed : 0.0,
+                (unsigned long long)stats->processed, (unsigned long long)stats->stolen,
+                deque_size( deque ), deque->dropped,
+                (unsigned long long)histogram_percentile( stats->latency, 50 ) / 1000,
+                (unsigned long long)histogram_percentile( stats->latency, 99 ) / 1000 );
+
+        for ( uint b = 0; b < LATENCY_BUCKETS; b++ ) all[b] += stats->latency[b];
+    }
+
+    printf( "\tAll handlers: p50 %lluus, p99 %lluus, p99.9 %lluus\n",
+            (unsigned long long)histogram_percentile( all, 50 ) / 1000,
+            (unsigned long long)histogram_percentile( all, 99 ) / 1000,
+            (unsigned long long)histogram_percentile( all, 99.9 ) / 1000 );
+}
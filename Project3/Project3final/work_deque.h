@@ -0,0 +1,70 @@
+#ifndef _WORK_DEQUE_H_
+#define _WORK_DEQUE_H_
+
+/* Description:
+ * Work-stealing event distribution.
+ * Every handler owns a bounded deque in shared memory. Generators push an
+ * event on the deque of a handler of the signal group (round robin) and
+ * emit the signal as a wake-up. A handler takes the oldest event of its own
+ * deque, and when that is empty it steals the oldest event of the fullest
+ * deque of any other handler, whatever its group. Events of a group without
+ * a registered handler go to any handler.
+ */
+#include <stdint.h>
+
+#define WORK_DEQUE_FILE    "/work-deques"
+#define WORK_DEQUE_SIZE    1024
+#define WORK_IDLE_WAIT_NS  1000000        /* retry stealing every 1ms when idle */
+#define LATENCY_BUCKETS    64
+
+struct work_item
+{
+    uint32_t type;
+    uint32_t source;
+    uint32_t seq;
+    uint64_t enqueued_ns;
+};
+
+struct work_stats
+{
+    pid_t    pid;
+    int      group;
+    uint32_t retire;                       /* set by the elastic pool */
+    uint64_t start_ns;
+    uint64_t busy_ns;
+    uint64_t processed;
+    uint64_t stolen;
+    uint64_t latency[ LATENCY_BUCKETS ];   /* log2 ns histogram */
+};
+
+struct work_deque
+{
+    uint32_t          lock;
+    uint32_t          head;               /* oldest item */
+    uint32_t          tail;               /* next free   */
+    uint32_t          dropped;
+    struct work_item  item[ WORK_DEQUE_SIZE ];
+    struct work_stats stats;
+};
+
+struct work_deques
+{
+    struct work_deque deque[ MAX_RX_PROCESSES ];
+};
+
+extern struct work_deques *work_deques;
+
+int  work_deque_init();
+void work_deque_remove();
+void work_deque_register( int slot, int group );
+void work_deque_unregister( int slot );
+void work_deque_retire( int slot );
+int  work_deque_retiring( int slot );
+uint work_deque_backlog();
+uint work_deque_group_backlog( int group );
+int  work_push( int type, uint source, uint32_t seq );
+int  work_take( int slot, struct work_item *item );
+void work_done( int slot, struct work_item *item, uint64_t started_ns );
+void work_deque_print_report();
+
+#endif /* _WORK_DEQUE_H_ */